@@ -0,0 +1,193 @@
+/*
+  ==============================================================================
+
+    BiquadCascade.h
+
+    A series of biquads processed in a single pass over the samples.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <array>
+#include <complex>
+#include <utility>
+
+/*
+ A plain copy of one normalised biquad (a0 == 1), in the same order JUCE stores them.
+ Unlike juce::dsp::IIR::Coefficients these can be copied around without touching the heap.
+ */
+struct BiquadCoefficients
+{
+    float b0 { 1.f }, b1 { 0.f }, b2 { 0.f }, a1 { 0.f }, a2 { 0.f };
+};
+
+//the same calculation IIR::Coefficients::getMagnitudeForFrequency does, without needing a Coefficients object
+inline double getMagnitudeForFrequency(const BiquadCoefficients& c, double frequency, double sampleRate)
+{
+    const auto jw = std::polar(1.0, -juce::MathConstants<double>::twoPi * frequency / sampleRate);
+    const auto jw2 = jw * jw;
+
+    const auto numerator = (double)c.b0 + (double)c.b1 * jw + (double)c.b2 * jw2;
+    const auto denominator = 1.0 + (double)c.a1 * jw + (double)c.a2 * jw2;
+
+    return std::abs(numerator / denominator);
+}
+
+/*
+ Running a ProcessorChain of IIR::Filters means every section makes its own pass over the block,
+ and every sample pays for the bypass checks of the sections that aren't in use.
+
+ BiquadCascade keeps the coefficients and the state of all of its sections in two contiguous arrays
+ and pushes each sample through every active section before moving on to the next sample.
+ The number of active sections is a template parameter of the inner loop, so there are no branches in it.
+ We pick the right instantiation from a table once per block.
+
+ Each section does the same transposed direct form II arithmetic as IIR::Filter,
+ so the output matches a chain of IIR::Filters with the same coefficients.
+ SampleType can be a float or a SIMDRegister, in which case every lane gets its own state.
+ */
+template<typename SampleType, int MaxSections>
+struct BiquadCascade
+{
+    static_assert(MaxSections > 0, "a cascade needs room for at least one section");
+
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        //all of our state is for one channel, so run one cascade per (SIMD) channel
+        jassert(spec.numChannels == 1);
+        juce::ignoreUnused(spec);
+        reset();
+    }
+
+    void reset()
+    {
+        state.fill(SampleType(0));
+    }
+
+    //only the first numSectionsToUse coefficients are used, the rest of the sections are skipped
+    void setCoefficients(const BiquadCoefficients* newCoefficients, int numSectionsToUse)
+    {
+        jassert(juce::isPositiveAndNotGreaterThan(numSectionsToUse, MaxSections));
+        numSections = juce::jlimit(0, MaxSections, numSectionsToUse);
+
+        std::copy(newCoefficients, newCoefficients + numSections, coefficients.begin());
+    }
+
+    int getNumSections() const { return numSections; }
+
+    /*
+     Call this before setCoefficients when sections are being added, removed or reordered,
+     so every section carries on with its own history instead of the one that used to be in its slot.
+     previousSlots[s] is where section s was before, or -1 if it's new and should start from silence.
+     */
+    void moveSectionStates(const int* previousSlots, int numSectionsToUse)
+    {
+        jassert(juce::isPositiveAndNotGreaterThan(numSectionsToUse, MaxSections));
+
+        auto previousState = state;
+        state.fill(SampleType(0));
+
+        for( int s = 0; s < juce::jmin(numSectionsToUse, MaxSections); ++s )
+        {
+            auto slot = previousSlots[s];
+            if( juce::isPositiveAndBelow(slot, MaxSections) )
+            {
+                state[(size_t)(2 * s)] = previousState[(size_t)(2 * slot)];
+                state[(size_t)(2 * s + 1)] = previousState[(size_t)(2 * slot + 1)];
+            }
+        }
+    }
+
+    template<typename ProcessContext>
+    void process(const ProcessContext& context)
+    {
+        const auto& inputBlock = context.getInputBlock();
+        auto& outputBlock = context.getOutputBlock();
+
+        jassert(inputBlock.getNumChannels() == 1);
+        jassert(inputBlock.getNumSamples() == outputBlock.getNumSamples());
+
+        if( context.usesSeparateInputAndOutputBlocks() )
+            outputBlock.copyFrom(inputBlock);
+
+        if( context.isBypassed )
+            return;
+
+        static constexpr auto processFunctions = makeProcessFunctions(std::make_index_sequence<MaxSections + 1>());
+
+        processFunctions[(size_t)numSections](coefficients.data(),
+                                              state.data(),
+                                              outputBlock.getChannelPointer(0),
+                                              outputBlock.getNumSamples());
+    }
+private:
+    using ProcessFunction = void (*)(const BiquadCoefficients*, SampleType*, SampleType*, size_t);
+
+    std::array<BiquadCoefficients, MaxSections> coefficients;
+    std::array<SampleType, 2 * MaxSections> state;
+    int numSections = 0;
+
+    template<int NumSections>
+    static void processSections(const BiquadCoefficients* sectionCoefficients,
+                                SampleType* sectionState,
+                                SampleType* samples,
+                                size_t numSamples)
+    {
+        if constexpr ( NumSections > 0 )
+        {
+            //keep everything in locals so the compiler can hold it in registers for the whole block
+            float b0[NumSections], b1[NumSections], b2[NumSections], a1[NumSections], a2[NumSections];
+            SampleType lv1[NumSections], lv2[NumSections];
+
+            for( int s = 0; s < NumSections; ++s )
+            {
+                b0[s] = sectionCoefficients[s].b0;
+                b1[s] = sectionCoefficients[s].b1;
+                b2[s] = sectionCoefficients[s].b2;
+                a1[s] = sectionCoefficients[s].a1;
+                a2[s] = sectionCoefficients[s].a2;
+
+                lv1[s] = sectionState[2 * s];
+                lv2[s] = sectionState[2 * s + 1];
+            }
+
+            for( size_t i = 0; i < numSamples; ++i )
+            {
+                auto input = samples[i];
+
+                for( int s = 0; s < NumSections; ++s )
+                {
+                    auto output = (input * b0[s]) + lv1[s];
+                    lv1[s] = (input * b1[s]) - (output * a1[s]) + lv2[s];
+                    lv2[s] = (input * b2[s]) - (output * a2[s]);
+                    input = output;
+                }
+
+                samples[i] = input;
+            }
+
+            for( int s = 0; s < NumSections; ++s )
+            {
+                juce::dsp::util::snapToZero(lv1[s]);
+                juce::dsp::util::snapToZero(lv2[s]);
+
+                sectionState[2 * s] = lv1[s];
+                sectionState[2 * s + 1] = lv2[s];
+            }
+        }
+        else
+        {
+            juce::ignoreUnused(sectionCoefficients, sectionState, samples, numSamples);
+        }
+    }
+
+    template<size_t... Counts>
+    static constexpr std::array<ProcessFunction, sizeof...(Counts)> makeProcessFunctions(std::index_sequence<Counts...>)
+    {
+        return { { &processSections<(int)Counts>... } };
+    }
+};
@@ -0,0 +1,157 @@
+/*
+  ==============================================================================
+
+    CoefficientDesign.h
+
+    Allocation free designers that write straight into BiquadCoefficients.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "BiquadCascade.h"
+
+#include <array>
+#include <cmath>
+
+/*
+ juce::dsp::FilterDesign hands back a heap allocated ReferenceCountedArray of Coefficients
+ and works out the analog prototype again every time it's called.
+
+ A Butterworth filter of order N splits into N/2 biquads, and section k only differs by its Q:
+
+    1/Q = 2 * cos((2k + 1) * pi / 2N)
+
+ We only ever use orders 2, 4, 6 and 8, so those values are tabulated below.
+ Designing a whole cascade then takes a single tan() for the bilinear transform,
+ which every section shares, and a few multiplies per section.
+ The formulas are the ones IIR::Coefficients::makeHighPass/makeLowPass use,
+ so the results match FilterDesign to within float rounding.
+ */
+namespace ButterworthPrototype
+{
+    //1/Q for each section, indexed by the number of sections - 1
+    constexpr float inverseQ[4][4]
+    {
+        { 1.4142135624f },
+        { 1.8477590650f, 0.7653668647f },
+        { 1.9318516526f, 1.4142135624f, 0.5176380902f },
+        { 1.9615705608f, 1.6629392246f, 1.1111404660f, 0.3901806440f }
+    };
+
+    constexpr int maxSections = 4;
+}
+
+//writes numSections biquads (an order of 2 * numSections) into sections
+inline void designButterworthHighPass(float frequency, double sampleRate, int numSections, BiquadCoefficients* sections)
+{
+    jassert(sampleRate > 0);
+    jassert(frequency > 0 && frequency <= sampleRate * 0.5);
+    jassert(juce::isPositiveAndNotGreaterThan(numSections, ButterworthPrototype::maxSections) && numSections > 0);
+
+    const auto n = std::tan(juce::MathConstants<float>::pi * frequency / static_cast<float>(sampleRate));
+    const auto nSquared = n * n;
+    const auto* inverseQ = ButterworthPrototype::inverseQ[numSections - 1];
+
+    for( int i = 0; i < numSections; ++i )
+    {
+        const auto invQTimesN = inverseQ[i] * n;
+        const auto c1 = 1.f / (1.f + invQTimesN + nSquared);
+
+        sections[i] = { c1, c1 * -2.f, c1, c1 * 2.f * (nSquared - 1.f), c1 * (1.f - invQTimesN + nSquared) };
+    }
+}
+
+//writes numSections biquads (an order of 2 * numSections) into sections
+inline void designButterworthLowPass(float frequency, double sampleRate, int numSections, BiquadCoefficients* sections)
+{
+    jassert(sampleRate > 0);
+    jassert(frequency > 0 && frequency <= sampleRate * 0.5);
+    jassert(juce::isPositiveAndNotGreaterThan(numSections, ButterworthPrototype::maxSections) && numSections > 0);
+
+    const auto n = 1.f / std::tan(juce::MathConstants<float>::pi * frequency / static_cast<float>(sampleRate));
+    const auto nSquared = n * n;
+    const auto* inverseQ = ButterworthPrototype::inverseQ[numSections - 1];
+
+    for( int i = 0; i < numSections; ++i )
+    {
+        const auto invQTimesN = inverseQ[i] * n;
+        const auto c1 = 1.f / (1.f + invQTimesN + nSquared);
+
+        sections[i] = { c1, c1 * 2.f, c1, c1 * 2.f * (1.f - nSquared), c1 * (1.f - invQTimesN + nSquared) };
+    }
+}
+
+//the same RBJ peak IIR::Coefficients::makePeakFilter designs
+inline BiquadCoefficients designPeak(double sampleRate, float frequency, float Q, float gainFactor)
+{
+    jassert(sampleRate > 0);
+    jassert(frequency > 0 && frequency <= sampleRate * 0.5);
+    jassert(Q > 0);
+
+    const auto A = juce::jmax(0.f, std::sqrt(gainFactor));
+    const auto omega = (juce::MathConstants<float>::twoPi * juce::jmax(frequency, 2.f)) / static_cast<float>(sampleRate);
+    const auto alpha = std::sin(omega) / (Q * 2.f);
+    const auto c2 = -2.f * std::cos(omega);
+    const auto alphaTimesA = alpha * A;
+    const auto alphaOverA = alpha / A;
+
+    const auto a0Inverse = 1.f / (1.f + alphaOverA);
+
+    return { (1.f + alphaTimesA) * a0Inverse,
+             c2 * a0Inverse,
+             (1.f - alphaTimesA) * a0Inverse,
+             c2 * a0Inverse,
+             (1.f - alphaOverA) * a0Inverse };
+}
+
+//the same RBJ low shelf IIR::Coefficients::makeLowShelf designs
+inline BiquadCoefficients designLowShelf(double sampleRate, float frequency, float Q, float gainFactor)
+{
+    jassert(sampleRate > 0);
+    jassert(frequency > 0 && frequency <= sampleRate * 0.5);
+    jassert(Q > 0);
+
+    const auto A = juce::jmax(0.f, std::sqrt(gainFactor));
+    const auto aMinus1 = A - 1.f;
+    const auto aPlus1 = A + 1.f;
+    const auto omega = (juce::MathConstants<float>::twoPi * juce::jmax(frequency, 2.f)) / static_cast<float>(sampleRate);
+    const auto cosOmega = std::cos(omega);
+    const auto beta = std::sin(omega) * std::sqrt(A) / Q;
+    const auto aMinus1TimesCos = aMinus1 * cosOmega;
+
+    const auto a0Inverse = 1.f / (aPlus1 + aMinus1TimesCos + beta);
+
+    return { A * (aPlus1 - aMinus1TimesCos + beta) * a0Inverse,
+             A * 2.f * (aMinus1 - aPlus1 * cosOmega) * a0Inverse,
+             A * (aPlus1 - aMinus1TimesCos - beta) * a0Inverse,
+             -2.f * (aMinus1 + aPlus1 * cosOmega) * a0Inverse,
+             (aPlus1 + aMinus1TimesCos - beta) * a0Inverse };
+}
+
+//the same RBJ high shelf IIR::Coefficients::makeHighShelf designs
+inline BiquadCoefficients designHighShelf(double sampleRate, float frequency, float Q, float gainFactor)
+{
+    jassert(sampleRate > 0);
+    jassert(frequency > 0 && frequency <= sampleRate * 0.5);
+    jassert(Q > 0);
+
+    const auto A = juce::jmax(0.f, std::sqrt(gainFactor));
+    const auto aMinus1 = A - 1.f;
+    const auto aPlus1 = A + 1.f;
+    const auto omega = (juce::MathConstants<float>::twoPi * juce::jmax(frequency, 2.f)) / static_cast<float>(sampleRate);
+    const auto cosOmega = std::cos(omega);
+    const auto beta = std::sin(omega) * std::sqrt(A) / Q;
+    const auto aMinus1TimesCos = aMinus1 * cosOmega;
+
+    const auto a0Inverse = 1.f / (aPlus1 - aMinus1TimesCos + beta);
+
+    return { A * (aPlus1 + aMinus1TimesCos + beta) * a0Inverse,
+             A * -2.f * (aMinus1 + aPlus1 * cosOmega) * a0Inverse,
+             A * (aPlus1 + aMinus1TimesCos - beta) * a0Inverse,
+             2.f * (aMinus1 - aPlus1 * cosOmega) * a0Inverse,
+             (aPlus1 - aMinus1TimesCos - beta) * a0Inverse };
+}
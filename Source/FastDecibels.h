@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    FastDecibels.h
+
+    Converts whole spectra to decibels in one vectorized pass.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#elif JUCE_ARM && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+ #include <arm_neon.h>
+ #define SIMPLEEQ_FAST_DECIBELS_NEON 1
+#endif
+
+#ifndef SIMPLEEQ_FAST_DECIBELS_NEON
+ #define SIMPLEEQ_FAST_DECIBELS_NEON 0
+#endif
+
+/*
+ The analyzer needs a log per bin, for every bin of every spectrum, and std::log10 is by far the slowest part of that.
+ For drawing, we don't need anything near log10's precision.
+
+ So the log is approximated the way floats are stored: x = m * 2^e, with m in [1, 2), so log2(x) = e + log2(m).
+ e comes straight out of the exponent bits, and log2(m) from a 4th order polynomial fitted to minimise the largest error.
+ That error is below 1.1e-4 in log2(x), which is less than 0.0004 dB after scaling to decibels
+ and about a thousandth of a pixel at the analyzer's scale.
+
+ The scaling, the log, throwing away NaNs and infinities and the clamp to negativeInfinity all happen in the same pass,
+ four values at a time with SSE2 or NEON, and one at a time on anything else or for whatever is left over.
+ */
+struct FastDecibels
+{
+    /*
+     Replaces every power in data with 10 * log10(power * scale), clamped to negativeInfinity.
+     Powers that are 0 or less, NaN or infinite become negativeInfinity, like 0 did with juce::Decibels.
+     Taking powers rather than magnitudes saves the square root per bin, 10 * log10(m * m) is 20 * log10(m).
+     */
+    static void powersToDecibels(float* data, int numValues, float scale, float negativeInfinity)
+    {
+        int i = 0;
+
+       #if JUCE_INTEL
+        const auto scaleV = _mm_set1_ps(scale);
+        const auto floorV = _mm_set1_ps(negativeInfinity);
+        const auto zeroV = _mm_setzero_ps();
+        const auto infinityV = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        const auto mantissaMask = _mm_set1_epi32(0x007fffff);
+        const auto oneBits = _mm_set1_epi32(0x3f800000);
+        const auto exponentBias = _mm_set1_epi32(127);
+        const auto oneV = _mm_set1_ps(1.f);
+        const auto c1 = _mm_set1_ps(coefficients[0]), c2 = _mm_set1_ps(coefficients[1]);
+        const auto c3 = _mm_set1_ps(coefficients[2]), c4 = _mm_set1_ps(coefficients[3]);
+        const auto decibelsV = _mm_set1_ps(decibelsPerDoubling);
+
+        for( ; i + 4 <= numValues; i += 4 )
+        {
+            auto power = _mm_mul_ps(_mm_loadu_ps(data + i), scaleV);
+
+            //false for NaNs too, since they never compare as anything
+            auto valid = _mm_and_ps(_mm_cmpgt_ps(power, zeroV), _mm_cmplt_ps(power, infinityV));
+
+            auto bits = _mm_castps_si128(power);
+            auto exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), exponentBias));
+            auto x = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), oneBits)), oneV);
+
+            auto polynomial = _mm_add_ps(c3, _mm_mul_ps(x, c4));
+            polynomial = _mm_add_ps(c2, _mm_mul_ps(x, polynomial));
+            polynomial = _mm_add_ps(c1, _mm_mul_ps(x, polynomial));
+
+            auto decibels = _mm_mul_ps(_mm_add_ps(exponent, _mm_mul_ps(x, polynomial)), decibelsV);
+            decibels = _mm_max_ps(decibels, floorV);
+
+            _mm_storeu_ps(data + i, _mm_or_ps(_mm_and_ps(valid, decibels), _mm_andnot_ps(valid, floorV)));
+        }
+       #elif SIMPLEEQ_FAST_DECIBELS_NEON
+        const auto scaleV = vdupq_n_f32(scale);
+        const auto floorV = vdupq_n_f32(negativeInfinity);
+        const auto zeroV = vdupq_n_f32(0.f);
+        const auto infinityV = vdupq_n_f32(std::numeric_limits<float>::infinity());
+        const auto mantissaMask = vdupq_n_u32(0x007fffff);
+        const auto oneBits = vdupq_n_u32(0x3f800000);
+        const auto exponentBias = vdupq_n_s32(127);
+        const auto oneV = vdupq_n_f32(1.f);
+        const auto c1 = vdupq_n_f32(coefficients[0]), c2 = vdupq_n_f32(coefficients[1]);
+        const auto c3 = vdupq_n_f32(coefficients[2]), c4 = vdupq_n_f32(coefficients[3]);
+        const auto decibelsV = vdupq_n_f32(decibelsPerDoubling);
+
+        for( ; i + 4 <= numValues; i += 4 )
+        {
+            auto power = vmulq_f32(vld1q_f32(data + i), scaleV);
+
+            //false for NaNs too, since they never compare as anything
+            auto valid = vandq_u32(vcgtq_f32(power, zeroV), vcltq_f32(power, infinityV));
+
+            auto bits = vreinterpretq_u32_f32(power);
+            auto exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), exponentBias));
+            auto x = vsubq_f32(vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissaMask), oneBits)), oneV);
+
+            auto polynomial = vmlaq_f32(c3, x, c4);
+            polynomial = vmlaq_f32(c2, x, polynomial);
+            polynomial = vmlaq_f32(c1, x, polynomial);
+
+            auto decibels = vmulq_f32(vmlaq_f32(exponent, x, polynomial), decibelsV);
+            decibels = vmaxq_f32(decibels, floorV);
+
+            vst1q_f32(data + i, vbslq_f32(valid, decibels, floorV));
+        }
+       #endif
+
+        for( ; i < numValues; ++i )
+            data[i] = powerToDecibels(data[i] * scale, negativeInfinity);
+    }
+
+    //the same approximation for a single value
+    static float powerToDecibels(float power, float negativeInfinity)
+    {
+        if( ! (power > 0.f && power < std::numeric_limits<float>::infinity()) )
+            return negativeInfinity;
+
+        uint32_t bits;
+        std::memcpy(&bits, &power, sizeof(bits));
+
+        auto exponent = (float)((int)(bits >> 23) - 127);
+
+        bits = (bits & 0x007fffff) | 0x3f800000;
+        float m;
+        std::memcpy(&m, &bits, sizeof(m));
+        auto x = m - 1.f;
+
+        auto polynomial = coefficients[0] + x * (coefficients[1] + x * (coefficients[2] + x * coefficients[3]));
+        return juce::jmax(negativeInfinity, (exponent + x * polynomial) * decibelsPerDoubling);
+    }
+
+    //the largest error of either function, compared to 10 * log10, for powers above the denormals
+    static constexpr float maxErrorInDecibels = 0.0004f;
+private:
+    //log2(1 + x) ~= x * (c1 + x * (c2 + x * (c3 + x * c4))) for x in [0, 1)
+    static constexpr float coefficients[4] { 1.4390165f, -0.67995903f, 0.32562775f, -0.084788477f };
+
+    //10 * log10(2), the decibels in a doubling of power
+    static constexpr float decibelsPerDoubling = 3.0102999566f;
+};
@@ -0,0 +1,396 @@
+/*
+  ==============================================================================
+
+    PartitionedConvolver.h
+
+    Uniformly partitioned overlap-save convolution, for running long FIRs in real time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+/*
+ The spectra of an FIR that has been cut into equal sized partitions.
+ Real and imaginary parts are stored separately, which keeps the multiply-accumulate
+ in the convolver a plain loop over floats that the compiler can vectorise.
+ */
+struct PartitionedKernel
+{
+    //allocates, so do this before processing starts
+    void prepare(int newPartitionSize, int newNumPartitions)
+    {
+        partitionSize = newPartitionSize;
+        numPartitions = newNumPartitions;
+
+        real.assign((size_t)(numPartitions * getNumBins()), 0.f);
+        imag.assign((size_t)(numPartitions * getNumBins()), 0.f);
+    }
+
+    //doesn't allocate or copy anything, so it's fine on the audio thread
+    void swap(PartitionedKernel& other) noexcept
+    {
+        jassert(other.partitionSize == partitionSize && other.numPartitions == numPartitions);
+
+        std::swap(partitionSize, other.partitionSize);
+        std::swap(numPartitions, other.numPartitions);
+        real.swap(other.real);
+        imag.swap(other.imag);
+    }
+
+    int getPartitionSize() const { return partitionSize; }
+    int getNumPartitions() const { return numPartitions; }
+
+    //each partition is zero padded to twice its length, which gives partitionSize + 1 unique bins
+    int getNumBins() const { return partitionSize + 1; }
+
+    float* getReal(int partition) { return real.data() + partition * getNumBins(); }
+    float* getImag(int partition) { return imag.data() + partition * getNumBins(); }
+    const float* getReal(int partition) const { return real.data() + partition * getNumBins(); }
+    const float* getImag(int partition) const { return imag.data() + partition * getNumBins(); }
+private:
+    int partitionSize = 0, numPartitions = 0;
+    std::vector<float> real, imag;
+};
+
+/*
+ Turns a magnitude response into a linear phase FIR, and that into a PartitionedKernel.
+
+ The magnitudes are sampled on the bins of a kernelLength point FFT with zero phase,
+ so the inverse transform gives an impulse that is symmetric around sample 0.
+ Rotating it by half its length makes it causal, at the cost of kernelLength / 2 samples of delay,
+ and a window tapers off the ends so the truncation doesn't ripple.
+ */
+class LinearPhaseKernelDesigner
+{
+public:
+    //allocates, so do this before processing starts
+    void prepare(int newKernelLength, int newPartitionSize)
+    {
+        jassert(juce::isPowerOfTwo(newKernelLength) && juce::isPowerOfTwo(newPartitionSize));
+        jassert(newPartitionSize <= newKernelLength);
+
+        kernelLength = newKernelLength;
+        partitionSize = newPartitionSize;
+
+        kernelFFT = std::make_unique<juce::dsp::FFT>(getOrder(kernelLength));
+        partitionFFT = std::make_unique<juce::dsp::FFT>(getOrder(2 * partitionSize));
+
+        impulse.assign((size_t)(2 * kernelLength), 0.f);
+        partitionData.assign((size_t)(4 * partitionSize), 0.f);
+
+        //symmetric around the centre tap. Tap 0 has no partner on the other side, so it stays at zero.
+        window.assign((size_t)kernelLength, 0.f);
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data() + 1,
+                                                                 (size_t)kernelLength - 1,
+                                                                 juce::dsp::WindowingFunction<float>::blackman,
+                                                                 false);
+    }
+
+    int getKernelLength() const { return kernelLength; }
+    int getPartitionSize() const { return partitionSize; }
+    int getNumPartitions() const { return kernelLength / partitionSize; }
+
+    //the delay of the centre tap
+    int getLatencySamples() const { return kernelLength / 2; }
+
+    //the magnitudes are sampled at bins 0 to kernelLength / 2, inclusive
+    int getNumBins() const { return kernelLength / 2 + 1; }
+    double getBinFrequency(int bin, double sampleRate) const { return bin * sampleRate / kernelLength; }
+
+    //binMagnitudes holds the linear gain the kernel should have at each of the getNumBins() bins
+    void design(const double* binMagnitudes, PartitionedKernel& kernel)
+    {
+        jassert(kernel.getPartitionSize() == partitionSize && kernel.getNumPartitions() == getNumPartitions());
+
+        std::fill(impulse.begin(), impulse.end(), 0.f);
+
+        for( int bin = 0; bin < getNumBins(); ++bin )
+            impulse[(size_t)(2 * bin)] = static_cast<float>(binMagnitudes[bin]);
+
+        kernelFFT->performRealOnlyInverseTransform(impulse.data());
+
+        auto first = impulse.begin();
+        std::rotate(first, first + kernelLength / 2, first + kernelLength);
+        juce::FloatVectorOperations::multiply(impulse.data(), window.data(), kernelLength);
+
+        const auto numBins = kernel.getNumBins();
+
+        for( int partition = 0; partition < getNumPartitions(); ++partition )
+        {
+            std::fill(partitionData.begin(), partitionData.end(), 0.f);
+            std::copy(first + partition * partitionSize, first + (partition + 1) * partitionSize, partitionData.begin());
+
+            partitionFFT->performRealOnlyForwardTransform(partitionData.data(), true);
+
+            auto* real = kernel.getReal(partition);
+            auto* imag = kernel.getImag(partition);
+
+            for( int bin = 0; bin < numBins; ++bin )
+            {
+                real[bin] = partitionData[(size_t)(2 * bin)];
+                imag[bin] = partitionData[(size_t)(2 * bin + 1)];
+            }
+        }
+    }
+private:
+    int kernelLength = 0, partitionSize = 0;
+
+    std::unique_ptr<juce::dsp::FFT> kernelFFT, partitionFFT;
+    std::vector<float> impulse, partitionData, window;
+
+    static int getOrder(int size) { return juce::roundToInt(std::log2((double)size)); }
+};
+
+/*
+ Convolving with a long FIR directly costs kernelLength multiplies per sample,
+ and doing it with one big FFT would mean waiting for kernelLength samples before any output.
+
+ Uniformly partitioned overlap-save splits the kernel into partitions of partitionSize samples.
+ Every partitionSize samples we transform the newest 2 * partitionSize input samples once,
+ push that spectrum onto a frequency domain delay line (FDL), multiply-accumulate the whole FDL
+ against the kernel's partitions and transform back. The latency is a single partition.
+
+ When a new kernel arrives it doesn't replace the old one straight away.
+ For a few partitions the FDL is run against both, and the outputs are crossfaded,
+ which only costs the extra multiply-accumulate and inverse FFT since the input spectra are shared.
+ */
+class UniformPartitionedConvolver
+{
+public:
+    //allocates, so do this before processing starts
+    void prepare(int numChannels, int newPartitionSize, int newNumPartitions)
+    {
+        jassert(juce::isPowerOfTwo(newPartitionSize) && newNumPartitions > 0);
+
+        partitionSize = newPartitionSize;
+        numPartitions = newNumPartitions;
+        crossfadeLength = crossfadePartitions * partitionSize;
+
+        fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2((double)(2 * partitionSize))));
+        fftData.assign((size_t)(4 * partitionSize), 0.f);
+
+        const auto numBins = (size_t)(partitionSize + 1);
+        accumulatorReal.assign(numBins, 0.f);
+        accumulatorImag.assign(numBins, 0.f);
+        crossfadeOutput.assign((size_t)partitionSize, 0.f);
+
+        channels.resize((size_t)juce::jmax(0, numChannels));
+
+        for( auto& channel : channels )
+        {
+            channel.inputFrame.assign((size_t)(2 * partitionSize), 0.f);
+            channel.output.assign((size_t)partitionSize, 0.f);
+            channel.fdlReal.assign(numBins * (size_t)numPartitions, 0.f);
+            channel.fdlImag.assign(numBins * (size_t)numPartitions, 0.f);
+        }
+
+        //silent until the first kernel is loaded
+        for( auto& kernel : kernels )
+            kernel.prepare(partitionSize, numPartitions);
+
+        reset();
+    }
+
+    void reset()
+    {
+        for( auto& channel : channels )
+        {
+            std::fill(channel.inputFrame.begin(), channel.inputFrame.end(), 0.f);
+            std::fill(channel.output.begin(), channel.output.end(), 0.f);
+            std::fill(channel.fdlReal.begin(), channel.fdlReal.end(), 0.f);
+            std::fill(channel.fdlImag.begin(), channel.fdlImag.end(), 0.f);
+        }
+
+        inputPosition = 0;
+        fdlHead = 0;
+
+        //there's no old output left to fade out of, so go straight to the newest kernel
+        if( isFading() )
+            finishCrossfade();
+    }
+
+    //a new kernel can only be loaded once the previous one has finished fading in
+    bool isFading() const { return crossfadePosition >= 0; }
+
+    /*
+     Takes the kernel's data rather than copying it, a long kernel is far too much to copy on the audio thread.
+     kernel gets the convolver's spare in exchange, so whatever reuses it has to overwrite all of it first.
+     If fade is false the kernel is swapped in immediately, which is only click free while nothing is playing.
+     */
+    void loadKernel(PartitionedKernel& kernel, bool fade = true)
+    {
+        jassert(! isFading());
+
+        kernels[(size_t)(1 - activeKernel)].swap(kernel);
+        crossfadePosition = 0;
+
+        if( ! fade )
+            finishCrossfade();
+    }
+
+    //the input has to fill a whole partition before any of it comes out
+    int getLatencySamples() const { return partitionSize; }
+
+    void process(const juce::dsp::AudioBlock<float>& block)
+    {
+        const auto numChannels = juce::jmin(block.getNumChannels(), channels.size());
+        const auto numSamples = block.getNumSamples();
+
+        size_t done = 0;
+
+        while( done < numSamples )
+        {
+            auto count = juce::jmin((size_t)(partitionSize - inputPosition), numSamples - done);
+
+            for( size_t c = 0; c < numChannels; ++c )
+            {
+                auto& channel = channels[c];
+                auto* samples = block.getChannelPointer(c) + done;
+
+                std::copy(samples, samples + count, channel.inputFrame.begin() + partitionSize + inputPosition);
+                std::copy(channel.output.begin() + inputPosition, channel.output.begin() + inputPosition + (int)count, samples);
+            }
+
+            inputPosition += (int)count;
+            done += count;
+
+            if( inputPosition == partitionSize )
+            {
+                processPartition(numChannels);
+                inputPosition = 0;
+            }
+        }
+    }
+private:
+    struct ChannelState
+    {
+        //the previous partition of input followed by the one being collected
+        std::vector<float> inputFrame;
+
+        //the convolved partition that's being played out while the next one is collected
+        std::vector<float> output;
+
+        //the spectra of the last numPartitions input frames, fdlHead is the newest
+        std::vector<float> fdlReal, fdlImag;
+    };
+
+    static constexpr int crossfadePartitions = 4;
+
+    int partitionSize = 0, numPartitions = 0, crossfadeLength = 0;
+    int inputPosition = 0, fdlHead = 0;
+
+    std::vector<ChannelState> channels;
+
+    std::array<PartitionedKernel, 2> kernels;
+    int activeKernel = 0;
+
+    //how far into the crossfade to the other kernel we are, or -1 if we aren't fading
+    int crossfadePosition = -1;
+
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> fftData, accumulatorReal, accumulatorImag, crossfadeOutput;
+
+    void finishCrossfade()
+    {
+        activeKernel = 1 - activeKernel;
+        crossfadePosition = -1;
+    }
+
+    void processPartition(size_t numChannels)
+    {
+        const auto numBins = partitionSize + 1;
+
+        for( size_t c = 0; c < numChannels; ++c )
+        {
+            auto& channel = channels[c];
+
+            std::copy(channel.inputFrame.begin(), channel.inputFrame.end(), fftData.begin());
+            std::fill(fftData.begin() + 2 * partitionSize, fftData.end(), 0.f);
+            fft->performRealOnlyForwardTransform(fftData.data(), true);
+
+            auto* real = channel.fdlReal.data() + fdlHead * numBins;
+            auto* imag = channel.fdlImag.data() + fdlHead * numBins;
+
+            for( int bin = 0; bin < numBins; ++bin )
+            {
+                real[bin] = fftData[(size_t)(2 * bin)];
+                imag[bin] = fftData[(size_t)(2 * bin + 1)];
+            }
+
+            //the newest partition becomes the oldest half of the next frame
+            std::copy(channel.inputFrame.begin() + partitionSize, channel.inputFrame.end(), channel.inputFrame.begin());
+
+            convolve(channel, kernels[(size_t)activeKernel], channel.output.data());
+
+            if( isFading() )
+            {
+                convolve(channel, kernels[(size_t)(1 - activeKernel)], crossfadeOutput.data());
+
+                for( int i = 0; i < partitionSize; ++i )
+                {
+                    auto gain = (float)(crossfadePosition + i + 1) / (float)crossfadeLength;
+                    channel.output[(size_t)i] += gain * (crossfadeOutput[(size_t)i] - channel.output[(size_t)i]);
+                }
+            }
+        }
+
+        fdlHead = (fdlHead + 1) % numPartitions;
+
+        if( isFading() )
+        {
+            crossfadePosition += partitionSize;
+
+            if( crossfadePosition >= crossfadeLength )
+                finishCrossfade();
+        }
+    }
+
+    //multiplies the channel's FDL with the kernel and writes the newest partitionSize samples of the result to output
+    void convolve(const ChannelState& channel, const PartitionedKernel& kernel, float* output)
+    {
+        const auto numBins = partitionSize + 1;
+
+        std::fill(accumulatorReal.begin(), accumulatorReal.end(), 0.f);
+        std::fill(accumulatorImag.begin(), accumulatorImag.end(), 0.f);
+
+        auto* accReal = accumulatorReal.data();
+        auto* accImag = accumulatorImag.data();
+
+        for( int partition = 0; partition < numPartitions; ++partition )
+        {
+            //partition 0 of the kernel goes with the newest input, partition 1 with the one before...
+            auto slot = (fdlHead - partition + numPartitions) % numPartitions;
+
+            const auto* xReal = channel.fdlReal.data() + slot * numBins;
+            const auto* xImag = channel.fdlImag.data() + slot * numBins;
+            const auto* hReal = kernel.getReal(partition);
+            const auto* hImag = kernel.getImag(partition);
+
+            for( int bin = 0; bin < numBins; ++bin )
+            {
+                accReal[bin] += xReal[bin] * hReal[bin] - xImag[bin] * hImag[bin];
+                accImag[bin] += xReal[bin] * hImag[bin] + xImag[bin] * hReal[bin];
+            }
+        }
+
+        for( int bin = 0; bin < numBins; ++bin )
+        {
+            fftData[(size_t)(2 * bin)] = accReal[bin];
+            fftData[(size_t)(2 * bin + 1)] = accImag[bin];
+        }
+
+        fft->performRealOnlyInverseTransform(fftData.data());
+
+        //the first half wrapped around from the end of the circular convolution, the second half is clean
+        std::copy(fftData.begin() + partitionSize, fftData.begin() + 2 * partitionSize, output);
+    }
+};
@@ -250,22 +250,41 @@ juce::String RotarySliderWithLabels::getDisplayString() const
 
 ResponseCurveComponent::ResponseCurveComponent(SimpleEQAudioProcessor& p) :
 audioProcessor(p),
-leftPathProducer(audioProcessor.leftChannelFifo),
-rightPathProducer(audioProcessor.rightChannelFifo)
+analyzerResolution(audioProcessor.apvts.getRawParameterValue("Analyzer Resolution")),
+chainParameters(audioProcessor.apvts),
+pathProducer(audioProcessor.leftChannelFifo, audioProcessor.rightChannelFifo)
 {
+    //the static layer covers every pixel, so whatever's behind us never needs painting when we repaint
+    setOpaque(true);
+    
     const auto& params = audioProcessor.getParameters();
     for ( auto param : params )
     {
+        auto sections = 0u;
+        if( auto* paramWithID = dynamic_cast<juce::AudioProcessorParameterWithID*>(param) )
+            sections = getSectionsForParameter(paramWithID->paramID);
+        
+        parameterSections.push_back(sections);
         param->addListener(this);
     }
     
-    updateChain();
+    updateChain(ChainSections::AllSections);
     
-    startTimerHz(60);
+    pathProducer.setWakeUpTarget(this);
+    analyzerThread->addProducer(pathProducer);
+    
+    startActiveRefresh();
 }
 
 ResponseCurveComponent::~ResponseCurveComponent()
 {
+    vBlankAttachment.reset();
+    stopTimer();
+    
+    //after this the AnalyzerThread can't trigger us any more, so anything it has already triggered can be cancelled
+    analyzerThread->removeProducer(pathProducer);
+    cancelPendingUpdate();
+    
     const auto& params = audioProcessor.getParameters();
     for ( auto param : params )
     {
@@ -275,10 +294,16 @@ ResponseCurveComponent::~ResponseCurveComponent()
 
 void ResponseCurveComponent::parameterValueChanged(int parameterIndex, float newValue)
 {
-    parametersChanged.set(true);
+    if( juce::isPositiveAndBelow(parameterIndex, (int)parameterSections.size()) )
+        dirtySections.fetch_or(parameterSections[(size_t)parameterIndex]);
+    
+    // Someone dragging a control should see the curve follow straight away.
+    // Changes from any other thread, like automation, are picked up by the idle timer.
+    if( juce::MessageManager::existsAndIsCurrentThread() )
+        startActiveRefresh();
 }
 
-void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
+bool PathProducer::process()
 {
     /*
      This is where we bring together the following to draw the spectrum analyzer:
@@ -288,155 +313,425 @@ void PathProducer::process(juce::Rectangle<float> fftBounds, double sampleRate)
      Our Path Producer
      The GUI
     */
+    
+    //the processor resizes the SCSFs' rings in prepareToPlay, and there's nothing to read until it has
+    if( ! enabled || ! leftChannelFifo->isPrepared() || ! rightChannelFifo->isPrepared() )
+    {
+        //whatever we show when we're switched back on has to be drawn, even if it's silence
+        lastWindowWasSilent = false;
+        return false;
+    }
+    
+    AnalyzerSettings settings;
+    
+    {
+        const juce::SpinLock::ScopedLockType lock(settingsLock);
+        settings = analyzerSettings;
+    }
+    
+    const auto fftBounds = settings.bounds;
+    const auto sampleRate = settings.sampleRate;
+    
+    if( sampleRate <= 0 || fftBounds.isEmpty() )
+        return false;
 
-    juce::AudioBuffer<float> tempIncomingBuffer;
+    // A new resolution is picked up here, on the only thread that ever touches the FFT, the window or the stereoBuffer,
+    // so they're never used half rebuilt and the message thread only ever sees finished paths
+    if( settings.order != fftDataGenerator.getOrder() )
+    {
+        fftDataGenerator.changeOrder(settings.order);
+        stereoBuffer.setSize(2, fftDataGenerator.getFFTSize());
+        lastWindowWasSilent = false;
+    }
+    
+    //the floor has moved, so it needs drawing again
+    if( fftBounds != lastBounds )
+    {
+        lastBounds = fftBounds;
+        lastWindowWasSilent = false;
+    }
 
-    // While there are buffers to pull from SCSF, if we can pull a buffer, we send it to the FFT Data Generator
-    // We need to be very careful to keep blocks in the same order throughout
-    while( leftChannelFifo->getNumCompleteBuffersAvailable() > 0 )
+    // Once a hop's worth of new samples has arrived we analyze the newest window, straight out of the SCSFs' rings.
+    // Only the newest spectrum ever gets drawn, so if several hops have gone by since the last pass
+    // the windows in between are skipped rather than computed and thrown away.
+    // Both SCSFs are filled by the same processBlock calls, so the left one speaks for the pair.
+    const auto windowSize = stereoBuffer.getNumSamples();
+    const auto hopSize = settings.getHopSize(windowSize);
+    
+    auto gotWindow = false;
+    
     {
-        if( leftChannelFifo->getAudioBuffer(tempIncomingBuffer) )
-        {
-            auto size = tempIncomingBuffer.getNumSamples();
-            
-            // First, shift everything in the monoBuffer forward by however many samples are in the tempIncomingBuffer
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0,0),
-                                              monoBuffer.getReadPointer(0, size),
-                                              monoBuffer.getNumSamples() - size);
-            
-            // Then, copy the samples from the tempIncomingBuffer to the monoBuffer
-            juce::FloatVectorOperations::copy(monoBuffer.getWritePointer(0,monoBuffer.getNumSamples() - size),
-                                              tempIncomingBuffer.getReadPointer(0,0),
-                                              size);
-            
-            // Send monoBuffers to the FFT Data Generator
-            leftChannelFFTDataGenerator.produceFFTDataForRendering(monoBuffer, -48.f);
-        }
+        // prepareToPlay can reallocate the rings at any time, and waits while we hold these.
+        // If it has already started, we try again next pass rather than wait for it.
+        const juce::SpinLock::ScopedTryLockType leftLock(leftChannelFifo->getReaderLock());
+        const juce::SpinLock::ScopedTryLockType rightLock(rightChannelFifo->getReaderLock());
+        
+        gotWindow = leftLock.isLocked() && rightLock.isLocked()
+                    && leftChannelFifo->isPrepared() && rightChannelFifo->isPrepared()
+                    && leftChannelFifo->getNumSamplesAvailable() >= hopSize
+                    && leftChannelFifo->readLatest(stereoBuffer.getWritePointer(Channel::Left), windowSize)
+                    && rightChannelFifo->readLatest(stereoBuffer.getWritePointer(Channel::Right), windowSize);
+    }
+    
+    if( gotWindow )
+    {
+        auto silent = stereoBuffer.getMagnitude(0, windowSize) < juce::Decibels::decibelsToGain(silenceThresholdDecibels);
+        
+        // Send the stereoBuffer to the FFT Data Generator, which does both channels with one FFT
+        if( ! (silent && lastWindowWasSilent) )
+            fftDataGenerator.produceFFTDataForRendering(stereoBuffer, -48.f);
+        
+        lastWindowWasSilent = silent;
     }
     
     // While there are FFT data buffers to pull, if we can pull a buffer, generatae a path
     
-    const auto fftSize = leftChannelFFTDataGenerator.getFFTSize();
+    const auto fftSize = fftDataGenerator.getFFTSize();
     const auto binWidth = sampleRate / (double)fftSize;
     
-    while( leftChannelFFTDataGenerator.getNumAvailableFFTDataBlocks() > 0 )
+    for( auto channel : { Channel::Left, Channel::Right } )
     {
-        std::vector<float> fftData;
-        if( leftChannelFFTDataGenerator.getFFTData(fftData) )
+        auto& pathGenerator = pathGenerators[channel];
+        
+        while( auto* fftData = fftDataGenerator.beginReadFFTData(channel) )
+        {
+            pathGenerator.generatePath(*fftData, fftBounds, fftSize, binWidth, -48.f);
+            fftDataGenerator.finishReadFFTData(channel);
+        }
+        
+        // While there are paths that can be pulled, pull as many as we can & publish the most recent path
+        
+        auto gotNewPath = false;
+        
+        while( pathGenerator.getNumPathsAvailable() > 0 )
+        {
+            gotNewPath = pathGenerator.getPath(fftPaths[channel]) || gotNewPath;
+        }
+        
+        //the editor gets the new path, and we get the stale one from the back buffer to build over next time
+        if( gotNewPath )
         {
-            pathProducer.generatePath(fftData, fftBounds, fftSize, binWidth, -48.f);
+            std::swap(latestPaths[channel].getWriteBuffer(), fftPaths[channel]);
+            latestPaths[channel].publish();
+            
+            if( wakeUpTarget != nullptr && wakeUpRequested.exchange(false) )
+                wakeUpTarget->triggerAsyncUpdate();
         }
     }
     
-    // While there are paths that can be pulled, pull as many as we can & display the most recent path
+    return gotWindow;
+}
+
+AnalyzerThread::AnalyzerThread() : juce::Thread("SimpleEQ analyzer")
+{
+    startThread();
+}
+
+AnalyzerThread::~AnalyzerThread()
+{
+    stopThread(1000);
+}
+
+void AnalyzerThread::addProducer(PathProducer& producer)
+{
+    {
+        const juce::ScopedLock lock(producersLock);
+        producers.addIfNotAlreadyThere(&producer);
+    }
+    
+    notify();
+}
+
+void AnalyzerThread::removeProducer(PathProducer& producer)
+{
+    const juce::ScopedLock lock(producersLock);
+    producers.removeFirstMatchingValue(&producer);
     
-    while( pathProducer.getNumPathsAvailable() > 0 )
+    //if it's being processed right now, wait for that to finish, so the producer can be deleted as soon as we return
+    while( busyProducer == &producer )
     {
-        pathProducer.getPath(leftChannelFFTPath);
+        const juce::ScopedUnlock unlock(producersLock);
+        producerFinished.wait(1);
     }
 }
 
-void ResponseCurveComponent::timerCallback()
+void AnalyzerThread::run()
 {
+    juce::Array<PathProducer*> producersToProcess;
+    auto intervalMs = pollIntervalMs;
+    
+    while( ! threadShouldExit() )
+    {
+        auto anyEnabled = false, anyNewSamples = false;
+        
+        {
+            const juce::ScopedLock lock(producersLock);
+            producersToProcess = producers;
+        }
+        
+        // The lock is only held to check that each producer is still there and to mark it as busy,
+        // so adding or removing a different one never has to wait for an analysis pass
+        for( auto* producer : producersToProcess )
+        {
+            {
+                const juce::ScopedLock lock(producersLock);
+                
+                if( ! producers.contains(producer) )
+                    continue;
+                
+                busyProducer = producer;
+            }
+            
+            anyEnabled = producer->isEnabled() || anyEnabled;
+            anyNewSamples = producer->process() || anyNewSamples;
+            
+            {
+                const juce::ScopedLock lock(producersLock);
+                busyProducer = nullptr;
+            }
+            
+            producerFinished.signal();
+        }
+        
+        // Disabled producers only get the one pass that resets them, then we sleep until one is enabled.
+        // Otherwise we poll quickly while audio is arriving, and slow down while it isn't.
+        if( ! anyEnabled )
+            intervalMs = -1;
+        else if( anyNewSamples )
+            intervalMs = pollIntervalMs;
+        else
+            intervalMs = juce::jlimit(pollIntervalMs, idlePollIntervalMs, intervalMs * 2);
+        
+        wait(intervalMs);
+    }
+}
+
+bool ResponseCurveComponent::updateFrame()
+{
+    auto changed = false;
+    
+    // The analysis itself happens on the AnalyzerThread, all we do here is tell it where to draw
+    // and pick up the paths it has finished
     if( shouldShowFFTAnalysis )
     {
-        auto fftBounds = getAnalysisArea().toFloat();
-        auto sampleRate = audioProcessor.getSampleRate();
+        AnalyzerSettings settings;
+        settings.bounds = getAnalysisArea().toFloat();
+        settings.sampleRate = audioProcessor.getSampleRate();
+        settings.overlap = analyzerOverlap;
+        settings.maxSpectraPerSecond = maxSpectraPerSecond;
+        settings.order = static_cast<FFTOrder>(FFTOrder::order2048 + juce::roundToInt(analyzerResolution->load()));
+        
+        pathProducer.setAnalysisSettings(settings);
         
-        leftPathProducer.process(fftBounds,sampleRate);
-        rightPathProducer.process(fftBounds, sampleRate);
+        //when the analyzer has nothing new, there's nothing to redraw
+        if( pathProducer.updatePaths() )
+        {
+            repaintAnalyzer();
+            changed = true;
+        }
     }
     
-    // If our parameters are changed, redraw the response curve:
-    if ( parametersChanged.compareAndSetBool(false, true) )
+    // If our parameters are changed, redraw the parts of the response curve they affect
+    auto sections = dirtySections.exchange(0);
+    auto sampleRate = audioProcessor.getSampleRate();
+    
+    // The filters can't be designed until the host has told us the sample rate, so there's nothing to redraw.
+    // The changes don't need keeping, the first real sample rate differs from designedSampleRate and redoes everything.
+    if( sampleRate <= 0 )
+        return changed;
+    
+    //a new sample rate moves every filter
+    if( sampleRate != designedSampleRate )
+        sections = ChainSections::AllSections;
+    
+    //this redraws the response curve's layer, if anything about it has changed
+    if( sections != 0 )
     {
-        //update the monochain
-        updateChain();
-        //signal a repaint
-        // repaint(); //no longer necesary here now that we are constantly repainting
+        updateChain(sections);
+        changed = true;
     }
     
-    repaint();
+    return changed;
 }
 
-void ResponseCurveComponent::updateChain()
+void ResponseCurveComponent::onVBlank()
 {
-    auto chainSettings = getChainSettings(audioProcessor.apvts);
-    
-    monoChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    monoChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    monoChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    //idle already, the timer just hasn't had the chance to drop us yet
+    if( isTimerRunning() )
+        return;
     
-    auto peakCoefficients = makePeakFilter(chainSettings,audioProcessor.getSampleRate());
-    updateCoefficients(monoChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    if( ! canBeSeen() )
+    {
+        startIdleRefresh();
+        return;
+    }
     
-    auto lowCutCoefficients = makeLowCutFilter(chainSettings, audioProcessor.getSampleRate());
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, audioProcessor.getSampleRate());
+    auto now = juce::Time::getMillisecondCounterHiRes();
     
-    updateCutFilter(monoChain.get<ChainPositions::LowCut>(), lowCutCoefficients,chainSettings.lowCutSlope);
-    updateCutFilter(monoChain.get<ChainPositions::HighCut>(), highCutCoefficients,chainSettings.highCutSlope);
+    if( updateFrame() )
+        lastActivityMs = now;
+    else if( now - lastActivityMs > idleDelayMs )
+        startIdleRefresh();
 }
 
+void ResponseCurveComponent::updateAnalyzerEnablement()
+{
+    auto shouldBeEnabled = shouldShowFFTAnalysis && canBeSeen();
+    
+    //the analyzer thread sleeps while no analyzer is on, so it has to be woken
+    if( shouldBeEnabled && ! pathProducer.isEnabled() )
+    {
+        pathProducer.setEnabled(true);
+        analyzerThread->notify();
+        return;
+    }
+    
+    pathProducer.setEnabled(shouldBeEnabled);
+}
 
-void ResponseCurveComponent::paint (juce::Graphics& g)
+void ResponseCurveComponent::startActiveRefresh()
 {
+    lastActivityMs = juce::Time::getMillisecondCounterHiRes();
+    stopTimer();
+    pathProducer.setWakeUpRequested(false);
     
-    using namespace juce;
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll (Colours::black);
+    if( vBlankAttachment == nullptr )
+        vBlankAttachment = std::make_unique<juce::VBlankAttachment>(this, [this] { onVBlank(); });
     
-    // Draw the frequency/gain grid
-    g.drawImage(background, getLocalBounds().toFloat());
+    updateAnalyzerEnablement();
+}
+
+void ResponseCurveComponent::startIdleRefresh()
+{
+    //this is usually called from the attachment's own callback, so the timer deletes it on its first tick instead
+    if( ! isTimerRunning() )
+        startTimerHz(idleRateHz);
     
-    auto responseArea = getAnalysisArea();
+    updateAnalyzerEnablement();
+    pathProducer.setWakeUpRequested(true);
+}
+
+void ResponseCurveComponent::timerCallback()
+{
+    vBlankAttachment.reset();
+    updateAnalyzerEnablement();
+    
+    //nobody can see anything we'd draw, so don't even look
+    if( ! canBeSeen() )
+        return;
     
-    auto w = responseArea.getWidth();
+    if( updateFrame() )
+        startActiveRefresh();
+}
+
+void ResponseCurveComponent::handleAsyncUpdate()
+{
+    if( canBeSeen() )
+        startActiveRefresh();
+}
 
-    auto& lowCut = monoChain.get<ChainPositions::LowCut>();
-    auto& peak = monoChain.get<ChainPositions::Peak>();
-    auto& highCut = monoChain.get<ChainPositions::HighCut>();
+bool ResponseCurveComponent::canBeSeen()
+{
+    if( ! isShowing() )
+        return false;
     
+    auto* peer = getPeer();
+    return peer != nullptr && ! peer->isMinimised();
+}
+
+void ResponseCurveComponent::visibilityChanged()
+{
+    if( canBeSeen() )
+        startActiveRefresh();
+    else
+        updateAnalyzerEnablement();
+}
+
+void ResponseCurveComponent::parentHierarchyChanged()
+{
+    visibilityChanged();
+}
+
+void ResponseCurveComponent::updateChain(uint32_t sections)
+{
     auto sampleRate = audioProcessor.getSampleRate();
     
-    std::vector<double> mags;
-    mags.resize(w);
+    //the filters can't be designed until the host has told us the sample rate, updateFrame() notices when it has
+    if( sampleRate <= 0 )
+        return;
     
-    for (int i = 0; i < w; ++i)
+    auto chainSettings = getChainSettings(chainParameters);
+    
+    if( sections & ChainSections::LowCutSection )
+        chainCoefficients.lowCut = makeLowCutCoefficients(chainSettings, sampleRate);
+    
+    if( sections & ChainSections::PeakSection )
+        chainCoefficients.peaks = makePeakCoefficients(chainSettings, sampleRate);
+    
+    if( sections & ChainSections::HighCutSection )
+        chainCoefficients.highCut = makeHighCutCoefficients(chainSettings, sampleRate);
+    
+    designedSampleRate = sampleRate;
+    
+    updateResponseCurve(sections);
+}
+
+void ResponseCurveComponent::updateResponseCurve(uint32_t sections)
+{
+    using namespace juce;
+    
+    auto responseArea = getAnalysisArea();
+    auto w = jmax(0, responseArea.getWidth());
+    
+    const auto sampleRate = designedSampleRate;
+    
+    // A new width puts different frequencies under every pixel, and a new sample rate moves them all relative to Nyquist,
+    // so either way the tables are rebuilt and every section has to be recalculated
+    if( (int)frequencies.size() != w || magnitudeResponse.getSampleRate() != sampleRate )
     {
-        double mag = 1.f;
-        auto freq = mapToLog10(double(i) / double(w), 20.0, 20000.0);
+        frequencies.resize((size_t)w);
+        for (int i = 0; i < w; ++i)
+            frequencies[(size_t)i] = mapToLog10(double(i) / double(w), 20.0, 20000.0);
         
-        if( ! monoChain.isBypassed<ChainPositions::Peak>())
-            mag *= peak.coefficients->getMagnitudeForFrequency(freq, sampleRate);
+        for( auto& magnitudes : sectionMagnitudes )
+            magnitudes.resize((size_t)w);
         
-        if( ! monoChain.isBypassed<ChainPositions::LowCut>())
-        {
-            if( ! lowCut.isBypassed<0>() )
-                mag *= lowCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( ! lowCut.isBypassed<1>() )
-                mag *= lowCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( ! lowCut.isBypassed<2>() )
-                mag *= lowCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( ! lowCut.isBypassed<3>() )
-                mag *= lowCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
+        if( sampleRate > 0 )
+            magnitudeResponse.prepare(frequencies.data(), w, sampleRate);
         
-        if( ! monoChain.isBypassed<ChainPositions::HighCut>())
-        {
-            if( ! highCut.isBypassed<0>() )
-                mag *= highCut.get<0>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( ! highCut.isBypassed<1>() )
-                mag *= highCut.get<1>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( ! highCut.isBypassed<2>() )
-                mag *= highCut.get<2>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-            if( ! highCut.isBypassed<3>() )
-                mag *= highCut.get<3>().coefficients->getMagnitudeForFrequency(freq, sampleRate);
-        }
+        sections = ChainSections::AllSections;
+    }
+    
+    auto updateSection = [&](ChainPositions position, const BiquadCoefficients* sectionCoefficients, int numSections)
+    {
+        if( (sections & (1u << position)) == 0 )
+            return;
+        
+        auto& magnitudes = sectionMagnitudes[position];
         
-        mags[i] = Decibels::gainToDecibels(mag);
+        //until there's a sample rate nothing has been designed, and the curve stays flat
+        if( sampleRate > 0 )
+            magnitudeResponse.getMagnitudes(sectionCoefficients, numSections, magnitudes.data());
+        else
+            std::fill(magnitudes.begin(), magnitudes.end(), 1.0);
+    };
+    
+    for( auto position : { ChainPositions::LowCut, ChainPositions::HighCut } )
+    {
+        const auto& cut = position == ChainPositions::LowCut ? chainCoefficients.lowCut : chainCoefficients.highCut;
+        updateSection(position, cut.sections.data(), cut.bypassed ? 0 : cut.getNumSections());
     }
     
-    Path responseCurve;
+    //the response of all of the active peak bands
+    updateSection(ChainPositions::Peak, chainCoefficients.peaks.bands.data(), chainCoefficients.peaks.numActiveBands);
+    
+    responseCurve.clear();
+    
+    if( w == 0 )
+    {
+        updateStaticLayer();
+        return;
+    }
     
     const double outputMin = responseArea.getBottom();
     const double outputMax = responseArea.getY();
@@ -445,16 +740,105 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
         return jmap(input,-24.0,24.0,outputMin,outputMax);
     };
     
-    responseCurve.startNewSubPath(responseArea.getX(), map(mags.front()));
+    responseCurve.preallocateSpace(3 * w);
     
-    for ( size_t i = 1 ; i < mags.size(); ++i )
+    for ( int i = 0; i < w; ++i )
     {
-        responseCurve.lineTo(responseArea.getX() + i, map(mags[i]));
+        auto mag = sectionMagnitudes[ChainPositions::LowCut][(size_t)i]
+                 * sectionMagnitudes[ChainPositions::Peak][(size_t)i]
+                 * sectionMagnitudes[ChainPositions::HighCut][(size_t)i];
+        
+        auto y = map(Decibels::gainToDecibels(mag));
+        
+        if( i == 0 )
+            responseCurve.startNewSubPath(responseArea.getX(), y);
+        else
+            responseCurve.lineTo(responseArea.getX() + i, y);
     }
     
+    updateStaticLayer();
+}
+
+void ResponseCurveComponent::updateStaticLayer()
+{
+    //until the first paint() tells us the real scale, the display's is the best guess
+    auto scale = staticLayerScale > 0 ? staticLayerScale : juce::Component::getApproximateScaleFactorForComponent(this);
+    renderStaticLayer(scale);
+    repaint();
+}
+
+void ResponseCurveComponent::renderStaticLayer(float scale)
+{
+    using namespace juce;
+    
+    // Rendered at the display's scale, so the cached layer is as sharp as drawing it all in paint() was
+    const auto width = roundToInt(getWidth() * scale);
+    const auto height = roundToInt(getHeight() * scale);
+    
+    staticLayerScale = scale;
+    
+    if( width <= 0 || height <= 0 )
+    {
+        staticLayer = Image();
+        return;
+    }
+    
+    if( staticLayer.getWidth() != width || staticLayer.getHeight() != height )
+        staticLayer = Image(Image::PixelFormat::RGB, width, height, false);
+    
+    Graphics g(staticLayer);
+    g.addTransform(AffineTransform::scale(scale));
+    
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    g.fillAll(Colours::black);
+    
+    drawGrid(g);
+    
+    g.setColour(Colour(242u, 65u, 163u)); //hot pink
+    g.strokePath(responseCurve, PathStrokeType(2.f));
+}
+
+void ResponseCurveComponent::repaintAnalyzer()
+{
+    auto newBounds = juce::Rectangle<int>();
+    
+    if( shouldShowFFTAnalysis )
+    {
+        auto pathBounds = pathProducer.getPath(Channel::Left).getBounds()
+                              .getUnion(pathProducer.getPath(Channel::Right).getBounds());
+        
+        //a little extra for the width of the strokes
+        newBounds = pathBounds.getSmallestIntegerContainer().expanded(2).getIntersection(getLocalBounds());
+    }
+    
+    auto dirty = newBounds.getUnion(analyzerBounds);
+    analyzerBounds = newBounds;
+    
+    if( ! dirty.isEmpty() )
+        repaint(dirty);
+}
+
+
+void ResponseCurveComponent::paint (juce::Graphics& g)
+{
+    using namespace juce;
+    
+    // The grid and the response curve come from the static layer. It's rebuilt here if the scale has changed,
+    // when we've been moved to a display with a different scale for example, so it never ends up blurry.
+    auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    if( scale != staticLayerScale )
+        renderStaticLayer(scale);
+    
+    // Being painted while idle usually means we've just become visible again, a restored window for example,
+    // which nothing else tells us about. Waking up from in here would create the VBlankAttachment mid-paint, so it's posted.
+    if( isTimerRunning() )
+        triggerAsyncUpdate();
+    
+    g.drawImage(staticLayer, getLocalBounds().toFloat());
+    
     if( shouldShowFFTAnalysis )
     {
-        auto leftChannelFFTPath = leftPathProducer.getPath();
+        const auto& leftChannelFFTPath = pathProducer.getPath(Channel::Left);
         
         //This transform is supposed to help align the analyzer inside the grid,
         //but it's not helping at the moment
@@ -464,7 +848,7 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
         g.setColour(Colour(0xff0CF2F2)); //hot blue
         g.strokePath(leftChannelFFTPath, PathStrokeType(1.f));
         
-        auto rightChannelFFTPath = rightPathProducer.getPath();
+        const auto& rightChannelFFTPath = pathProducer.getPath(Channel::Right);
         
         //This transform is supposed to help align the analyzer inside the grid,
         //but it's not helping at the moment
@@ -478,23 +862,18 @@ void ResponseCurveComponent::paint (juce::Graphics& g)
     //draw a rectangle around the render area
     //g.setColour(Colour(0xacf241a3));
     //g.drawRoundedRectangle(getRenderArea().toFloat(), 4.f, 1.f);
-    
-    g.setColour(Colour(242u, 65u, 163u)); //hot pink
-    g.strokePath(responseCurve, PathStrokeType(2.f));
-    
 }
 
 void ResponseCurveComponent::resized()
+{
+    //the curve's pixels have moved, and if the width has changed, so have its frequencies. This redraws the grid too.
+    updateResponseCurve(0);
+}
+
+void ResponseCurveComponent::drawGrid(juce::Graphics& g)
 {
     using namespace juce;
     
-    //make a new background image based on the width and height of the component
-    background = Image(Image::PixelFormat::RGB, getWidth(), getHeight(), true);
-    
-    //create a graphics context
-    Graphics g(background);
-    
-    //paint into the background image using the graphics content we created
     Array<float> freqs
     {
         20, /*30, 40, 50, */100,
@@ -620,6 +999,76 @@ juce::Rectangle<int> ResponseCurveComponent::getAnalysisArea()
     return bounds;
 };
 
+//==============================================================================
+void ProcessLoadComponent::timerCallback()
+{
+    if( update() )
+        repaint();
+}
+
+bool ProcessLoadComponent::update()
+{
+    using namespace juce;
+    
+    auto stats = audioProcessor.getProcessBlockStats();
+    auto percent = [](float load) { return String(load * 100.f, 1) + "%"; };
+    
+    String str;
+    
+    if( stats.numBlocks == 0 )
+        str = "DSP load: not processing";
+    else
+        str << "DSP load  p50 " << percent(stats.p50Load)
+            << "  p99 " << percent(stats.p99Load)
+            << "  max " << percent(stats.maxLoad)
+            << "  (" << stats.lastBlockSize << " samples)";
+    
+    if( stats.numOverruns > 0 )
+        str << "  " << stats.numOverruns << " overruns";
+    
+    auto over = stats.maxLoad >= 1.f;
+    
+    if( str == text && over == overBudget )
+        return false;
+    
+    text = str;
+    overBudget = over;
+    return true;
+}
+
+void ProcessLoadComponent::paint(juce::Graphics& g)
+{
+    using namespace juce;
+    
+    //anything over budget is shown in the same pink as the response curve
+    g.setColour(overBudget ? Colour(242u, 65u, 163u) : Colour(105u,60u,28u));
+    g.setFont(14);
+    g.drawFittedText(text, getLocalBounds(), Justification::centredRight, 1);
+}
+
+void ProcessLoadComponent::visibilityChanged()
+{
+    if( isShowing() )
+    {
+        if( isTimerRunning() )
+            return;
+        
+        //whatever changed while it was hidden is shown straight away
+        update();
+        repaint();
+        startTimerHz(4);
+    }
+    else
+    {
+        stopTimer();
+    }
+}
+
+void ProcessLoadComponent::parentHierarchyChanged()
+{
+    visibilityChanged();
+}
+
 //==============================================================================
 SimpleEQAudioProcessorEditor::SimpleEQAudioProcessorEditor (SimpleEQAudioProcessor& p)
     : AudioProcessorEditor (&p), audioProcessor (p),
@@ -632,16 +1081,13 @@ lowCutSlopeSlider(*audioProcessor.apvts.getParameter("LowCut Slope"), "dB/Oct"),
 highCutSlopeSlider(*audioProcessor.apvts.getParameter("HighCut Slope"), "dB/Oct"),
 
 responseCurveComponent(audioProcessor),
-peakFreqSliderAttachment(audioProcessor.apvts, "Peak Freq", peakFreqSlider),
-peakGainSliderAttachment(audioProcessor.apvts, "Peak Gain", peakGainSlider),
-peakQualitySliderAttachment(audioProcessor.apvts, "Peak Quality", peakQualitySlider),
+processLoadComponent(audioProcessor),
 lowCutFreqSliderAttachment(audioProcessor.apvts, "LowCut Freq", lowCutFreqSlider),
 highCutFreqSliderAttachment(audioProcessor.apvts, "HighCut Freq", highCutFreqSlider),
 lowCutSlopeSliderAttachment(audioProcessor.apvts, "LowCut Slope", lowCutSlopeSlider),
 highCutSlopeSliderAttachment(audioProcessor.apvts, "HighCut Slope", highCutSlopeSlider),
 
 lowCutBypassButtonAttachment(audioProcessor.apvts,"LowCut Bypassed", lowCutBypassButton),
-peakBypassButtonAttachment(audioProcessor.apvts,"Peak Bypassed", peakBypassButton),
 highCutBypassButtonAttachment(audioProcessor.apvts,"HighCut Bypassed", highCutBypassButton),
 analyzerEnabledButtonAttachment(audioProcessor.apvts,"Analyzer Enabled", analyzerEnabledButton)
 {
@@ -685,14 +1131,33 @@ analyzerEnabledButtonAttachment(audioProcessor.apvts,"Analyzer Enabled", analyze
         // If the safeptr exists, get the bypass state and set slider enablement accoridngly
         if( auto* comp = safePtr.getComponent() )
         {
-            auto bypassed = comp->peakBypassButton.getToggleState();
-            
-            comp->peakFreqSlider.setEnabled( !bypassed);
-            comp->peakGainSlider.setEnabled( !bypassed);
-            comp->peakQualitySlider.setEnabled( !bypassed);
+            comp->updatePeakControlsEnablement();
         }
     };
     
+    for( int band = 0; band < NumPeakBands; ++band )
+        peakBandSelector.addItem("Band " + juce::String(band + 1), band + 1);
+    
+    //every band has the same choices, so take them from the first one
+    if( auto* typeParam = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.apvts.getParameter(getPeakParameterID(0, "Type"))) )
+        peakTypeSelector.addItemList(typeParam->choices, 1);
+    
+    peakBandSelector.onChange = [safePtr]()
+    {
+        if( auto* comp = safePtr.getComponent() )
+        {
+            comp->selectPeakBand(comp->peakBandSelector.getSelectedItemIndex());
+        }
+    };
+    
+    peakBandSelector.setSelectedItemIndex(0, juce::dontSendNotification);
+    selectPeakBand(0);
+    
+    if( auto* resolutionParam = dynamic_cast<juce::AudioParameterChoice*>(audioProcessor.apvts.getParameter("Analyzer Resolution")) )
+        analyzerResolutionSelector.addItemList(resolutionParam->choices, 1);
+    
+    analyzerResolutionSelectorAttachment = std::make_unique<ComboBoxAttachment>(audioProcessor.apvts, "Analyzer Resolution", analyzerResolutionSelector);
+    
     lowCutBypassButton.onClick = [safePtr]()
     {
         if( auto* comp = safePtr.getComponent())
@@ -753,6 +1218,8 @@ void SimpleEQAudioProcessorEditor::resized()
     auto bounds = getLocalBounds();
     
     auto analyzerEnabledArea = bounds.removeFromTop(25);
+    analyzerResolutionSelector.setBounds(analyzerEnabledArea.withX(110).withWidth(90).reduced(0, 2));
+    processLoadComponent.setBounds(analyzerEnabledArea.withTrimmedLeft(200).reduced(5, 2));
     analyzerEnabledArea.setWidth(100);
     analyzerEnabledArea.setX(5);
     analyzerEnabledArea.removeFromTop(2);
@@ -780,6 +1247,11 @@ void SimpleEQAudioProcessorEditor::resized()
     highCutSlopeSlider.setBounds(highCutArea);
     
     peakBypassButton.setBounds(bounds.removeFromTop(25));
+    
+    auto peakSelectorArea = bounds.removeFromTop(25);
+    peakBandSelector.setBounds(peakSelectorArea.removeFromLeft(peakSelectorArea.getWidth() / 2).reduced(2));
+    peakTypeSelector.setBounds(peakSelectorArea.reduced(2));
+    
     peakFreqSlider.setBounds(bounds.removeFromTop(bounds.getHeight() * 0.33));
     peakGainSlider.setBounds(bounds.removeFromTop(bounds.getHeight() * 0.5));
     peakQualitySlider.setBounds(bounds);
@@ -797,10 +1269,55 @@ std::vector<juce::Component*> SimpleEQAudioProcessorEditor::getComps()
         &lowCutSlopeSlider,
         &highCutSlopeSlider,
         &responseCurveComponent,
+        &processLoadComponent,
         
         &lowCutBypassButton,
         &highCutBypassButton,
         &peakBypassButton,
-        &analyzerEnabledButton
+        &analyzerEnabledButton,
+        
+        &peakBandSelector,
+        &peakTypeSelector,
+        &analyzerResolutionSelector
     };
 }
+
+void SimpleEQAudioProcessorEditor::selectPeakBand(int band)
+{
+    band = juce::jlimit(0, NumPeakBands - 1, band);
+    auto& apvts = audioProcessor.apvts;
+    
+    // The old attachments have to go before the new ones are made,
+    // otherwise both would be driving the same controls
+    peakFreqSliderAttachment.reset();
+    peakGainSliderAttachment.reset();
+    peakQualitySliderAttachment.reset();
+    peakBypassButtonAttachment.reset();
+    peakTypeSelectorAttachment.reset();
+    
+    auto freqID = getPeakParameterID(band, "Freq");
+    auto gainID = getPeakParameterID(band, "Gain");
+    auto qualityID = getPeakParameterID(band, "Quality");
+    
+    peakFreqSlider.setParameter(*apvts.getParameter(freqID));
+    peakGainSlider.setParameter(*apvts.getParameter(gainID));
+    peakQualitySlider.setParameter(*apvts.getParameter(qualityID));
+    
+    peakFreqSliderAttachment = std::make_unique<Attachment>(apvts, freqID, peakFreqSlider);
+    peakGainSliderAttachment = std::make_unique<Attachment>(apvts, gainID, peakGainSlider);
+    peakQualitySliderAttachment = std::make_unique<Attachment>(apvts, qualityID, peakQualitySlider);
+    peakBypassButtonAttachment = std::make_unique<ButtonAttachment>(apvts, getPeakParameterID(band, "Bypassed"), peakBypassButton);
+    peakTypeSelectorAttachment = std::make_unique<ComboBoxAttachment>(apvts, getPeakParameterID(band, "Type"), peakTypeSelector);
+    
+    updatePeakControlsEnablement();
+}
+
+void SimpleEQAudioProcessorEditor::updatePeakControlsEnablement()
+{
+    auto bypassed = peakBypassButton.getToggleState();
+    
+    peakFreqSlider.setEnabled( !bypassed);
+    peakGainSlider.setEnabled( !bypassed);
+    peakQualitySlider.setEnabled( !bypassed);
+    peakTypeSelector.setEnabled( !bypassed);
+}
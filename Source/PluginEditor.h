@@ -10,92 +10,120 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "FastDecibels.h"
 
-enum FFTOrder
-{
-    order2048 = 11,
-    order4096 = 12,
-    order8192 = 13
-};
-
+/*
+ Produces the spectra of both channels with a single FFT.
+ 
+ The left channel goes in as the real part and the right channel as the imaginary part of one complex FFT.
+ The spectrum of a real signal is conjugate symmetric, which lets us pull the two apart again afterwards:
+     L[k] = (X[k] + conj(X[N - k])) / 2
+     R[k] = (X[k] - conj(X[N - k])) / 2i
+ So the pair costs one windowing pass, one FFT and one normalization pass, instead of two of each.
+ */
 template<typename BlockType>
 struct FFTDataGenerator
 {
     /**
      produces the FFT data from an audio buffer.
+     audioData's channels are numbered like Channel, so the left channel is Channel::Left.
      */
     void produceFFTDataForRendering(const juce::AudioBuffer<float>& audioData, const float negativeInfinity)
     {
+        jassert(audioData.getNumChannels() >= 2);
+        
         const auto fftSize = getFFTSize();
         
-        fftData.assign(fftData.size(), 0);
-        auto* readIndex = audioData.getReadPointer(0);
-        std::copy(readIndex, readIndex + fftSize, fftData.begin());
+        // The data is produced right in the fifos' slots. If the reader is that far behind, this block is dropped.
+        // Both fifos are written and read together, so they're always either both full or neither is.
+        auto* leftSlot = fftDataFifos[Channel::Left].beginWrite();
+        auto* rightSlot = fftDataFifos[Channel::Right].beginWrite();
+        if( leftSlot == nullptr || rightSlot == nullptr )
+            return;
+        
+        auto* left = audioData.getReadPointer(Channel::Left);
+        auto* right = audioData.getReadPointer(Channel::Right);
         
-        // first apply a windowing function to our data
-        window->multiplyWithWindowingTable (fftData.data(), fftSize);       // [1]
+        // first apply a windowing function to our data, to both channels at once
+        for( int i = 0; i < fftSize; ++i )
+            timeData[(size_t)i] = { left[i] * window[(size_t)i], right[i] * window[(size_t)i] };
         
         // then render our FFT data..
-        forwardFFT->performFrequencyOnlyForwardTransform (fftData.data());  // [2]
+        forwardFFT->perform(timeData.data(), frequencyData.data(), false);
         
         int numBins = (int)fftSize / 2;
+        auto& leftData = *leftSlot;
+        auto& rightData = *rightSlot;
         
-        //normalize the fft values.
-        for( int i = 0; i < numBins; ++i )
+        //separate the channels. What we keep is each bin's power, |X|^2, so there's no square root to take.
+        for( int k = 0; k < numBins; ++k )
         {
-            auto v = fftData[i];
-//            fftData[i] /= (float) numBins;
-            if( !std::isinf(v) && !std::isnan(v) )
-            {
-                v /= float(numBins);
-            }
-            else
-            {
-                v = 0.f;
-            }
-            fftData[i] = v;
+            auto x = frequencyData[(size_t)k];
+            auto mirrored = std::conj(frequencyData[(size_t)((fftSize - k) & (fftSize - 1))]);
+            
+            leftData[(size_t)k] = std::norm(x + mirrored);
+            rightData[(size_t)k] = std::norm(x - mirrored);
         }
         
-        //convert them to decibels
-        for( int i = 0; i < numBins; ++i )
-        {
-            fftData[i] = juce::Decibels::gainToDecibels(fftData[i], negativeInfinity);
-        }
+        // The halving that separates the channels and the normalization by the number of bins are applied to the magnitudes,
+        // so squared they're one scale for the powers. That, the clean up and the conversion to decibels are a single pass.
+        const auto scale = 0.25f / float(numBins * numBins);
+        FastDecibels::powersToDecibels(leftData.data(), numBins, scale, negativeInfinity);
+        FastDecibels::powersToDecibels(rightData.data(), numBins, scale, negativeInfinity);
         
-        fftDataFifo.push(fftData);
+        fftDataFifos[Channel::Left].finishWrite();
+        fftDataFifos[Channel::Right].finishWrite();
     }
     
     void changeOrder(FFTOrder newOrder)
     {
-        //when you change order, recreate the window, forwardFFT, fifo, fftData
-        //also reset the fifoIndex
+        //when you change order, recreate the window, forwardFFT, fifos and the FFT's buffers
         //things that need recreating should be created on the heap via std::make_unique<>
         
         order = newOrder;
         auto fftSize = getFFTSize();
         
         forwardFFT = std::make_unique<juce::dsp::FFT>(order);
-        window = std::make_unique<juce::dsp::WindowingFunction<float>>(fftSize, juce::dsp::WindowingFunction<float>::blackmanHarris);
         
-        fftData.clear();
-        fftData.resize(fftSize * 2, 0);
-
-        fftDataFifo.prepare(fftData.size());
+        //the same table juce::dsp::WindowingFunction would make, it just can't window complex data for us
+        window.resize((size_t)fftSize);
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(window.data(),
+                                                                 (size_t)fftSize,
+                                                                 juce::dsp::WindowingFunction<float>::blackmanHarris,
+                                                                 true);
+        
+        timeData.assign((size_t)fftSize, {});
+        frequencyData.assign((size_t)fftSize, {});
+        
+        for( auto& fifo : fftDataFifos )
+            fifo.prepare((size_t)fftSize / 2);
     }
     //==============================================================================
     int getFFTSize() const { return 1 << order; }
-    int getNumAvailableFFTDataBlocks() const { return fftDataFifo.getNumAvailableForReading(); }
+    FFTOrder getOrder() const { return order; }
+    int getNumAvailableFFTDataBlocks(Channel channel) const { return fftDataFifos[channel].getNumAvailableForReading(); }
     //==============================================================================
-    bool getFFTData(BlockType& fftData) { return fftDataFifo.pull(fftData); }
+    //borrows the channel's oldest FFT data without copying it, or returns nullptr if there isn't any
+    const BlockType* beginReadFFTData(Channel channel) { return fftDataFifos[channel].beginRead(); }
+    
+    //hands the data from beginReadFFTData() back, so it can be written over
+    void finishReadFFTData(Channel channel) { fftDataFifos[channel].finishRead(); }
 private:
     FFTOrder order;
-    BlockType fftData;
     std::unique_ptr<juce::dsp::FFT> forwardFFT;
-    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    std::vector<float> window;
+    std::vector<juce::dsp::Complex<float>> timeData, frequencyData;
     
-    Fifo<BlockType> fftDataFifo;
+    //indexed by Channel
+    std::array<Fifo<BlockType>, 2> fftDataFifos;
 };
 
+/*
+ At the top of the spectrum hundreds of bins can land on the same pixel, while at the bottom they're pixels apart.
+ So the bins are grouped into the pixel columns they land on, and every column becomes one point of the path.
+ That keeps the number of points, and the cost of building and stroking the path, down to the width of the analyzer
+ whatever the FFT size is.
+ */
 template<typename PathType>
 struct AnalyzerPathGenerator
 {
@@ -114,8 +142,18 @@ struct AnalyzerPathGenerator
 
         int numBins = (int)fftSize / 2;
 
-        PathType p;
-        p.preallocateSpace(3 * (int)fftBounds.getWidth());
+        //only changes when the analyzer is resized, or the FFT order or the sample rate changes
+        if( width != columnsWidth || numBins != columnsNumBins || binWidth != columnsBinWidth )
+            updateColumns(width, numBins, binWidth);
+
+        // The path is built right in the fifo's slot, reusing whatever space the path that was there last had
+        auto* slot = pathFifo.beginWrite();
+        if( slot == nullptr )
+            return;
+        
+        PathType& p = *slot;
+        p.clear();
+        p.preallocateSpace(3 * ((int)columns.size() + 1));
 
         auto map = [bottom, top, negativeInfinity](float v)
         {
@@ -124,32 +162,21 @@ struct AnalyzerPathGenerator
                               float(bottom+10),   top);
         };
 
-        auto y = map(renderData[0]);
-
-//        jassert( !std::isnan(y) && !std::isinf(y) );
-        if( std::isnan(y) || std::isinf(y) )
-            y = bottom;
-        
-        p.startNewSubPath(0, y);
-
-        const int pathResolution = 2; //you can draw line-to's every 'pathResolution' pixels.
-
-        for( int binNum = 1; binNum < numBins; binNum += pathResolution )
+        // Each column is drawn at the loudest of its bins, so a narrow peak still shows up where the bins are packed tight.
+        // renderData never holds NaNs or infinities, FastDecibels has already replaced them.
+        for( size_t i = 0; i < columns.size(); ++i )
         {
-            y = map(renderData[binNum]);
-
-//            jassert( !std::isnan(y) && !std::isinf(y) );
+            const auto& column = columns[i];
+            auto loudest = *std::max_element(renderData.begin() + column.firstBin, renderData.begin() + column.endBin);
+            auto y = map(loudest);
 
-            if( !std::isnan(y) && !std::isinf(y) )
-            {
-                auto binFreq = binNum * binWidth;
-                auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
-                int binX = std::floor(normalizedBinX * width);
-                p.lineTo(binX, y);
-            }
+            if( i == 0 )
+                p.startNewSubPath(column.x, y);
+            else
+                p.lineTo(column.x, y);
         }
 
-        pathFifo.push(p);
+        pathFifo.finishWrite();
     }
 
     int getNumPathsAvailable() const
@@ -157,12 +184,50 @@ struct AnalyzerPathGenerator
         return pathFifo.getNumAvailableForReading();
     }
 
+    //swaps the oldest path into 'path', and the old contents of 'path' go back to be built over
     bool getPath(PathType& path)
     {
-        return pathFifo.pull(path);
+        return pathFifo.pullBySwap(path);
     }
 private:
     Fifo<PathType> pathFifo;
+
+    //the bins [firstBin, endBin) all land on the pixel column at x
+    struct Column
+    {
+        int firstBin, endBin;
+        float x;
+    };
+
+    std::vector<Column> columns;
+    float columnsWidth = 0, columnsBinWidth = 0;
+    int columnsNumBins = 0;
+
+    /*
+     Works out which column every bin from 1 up lands on. The DC bin is left out, like it always was.
+     Bins below 20 Hz or above 20 kHz join the columns at the edges, so there are never more than width + 1 columns.
+     */
+    void updateColumns(float width, int numBins, float binWidth)
+    {
+        columns.clear();
+        columns.reserve((size_t)juce::jmax(0, (int)width + 1));
+
+        for( int binNum = 1; binNum < numBins; ++binNum )
+        {
+            auto binFreq = binNum * binWidth;
+            auto normalizedBinX = juce::mapFromLog10(binFreq, 20.f, 20000.f);
+            auto binX = juce::jlimit(0.f, width, std::floor(normalizedBinX * width));
+
+            if( ! columns.empty() && columns.back().x == binX )
+                columns.back().endBin = binNum + 1;
+            else
+                columns.push_back({ binNum, binNum + 1, binX });
+        }
+
+        columnsWidth = width;
+        columnsNumBins = numBins;
+        columnsBinWidth = binWidth;
+    }
 };
 
 //===============================================================================
@@ -212,6 +277,13 @@ struct RotarySliderWithLabels : juce::Slider
     int getTextHeight() const { return 14; }
     juce::String getDisplayString() const;
     
+    //points the label at a different parameter, for controls that can be attached to more than one
+    void setParameter(juce::RangedAudioParameter& rap)
+    {
+        param = &rap;
+        repaint();
+    }
+    
 private:
     LookAndFeel lnf;
     
@@ -219,36 +291,162 @@ private:
     juce::String suffix;
 };
 
+struct AnalyzerSettings
+{
+    juce::Rectangle<float> bounds;
+    double sampleRate = 0;
+    
+    //how much each window overlaps the one before, from 0 up to (but not including) 1
+    float overlap = 0.5f;
+    
+    //there's no point analyzing more often than the display can show the results
+    double maxSpectraPerSecond = 60;
+    
+    FFTOrder order = FFTOrder::order2048;
+    
+    // The number of new samples between two spectra.
+    // It only depends on the window and the settings, however small the host's blocks are.
+    int getHopSize(int windowSize) const
+    {
+        auto overlapHop = windowSize * (1.0 - juce::jlimit(0.0, 0.99, (double)overlap));
+        auto rateHop = maxSpectraPerSecond > 0 ? sampleRate / maxSpectraPerSecond : 0.0;
+        
+        return juce::jmax(1, juce::roundToInt(juce::jmax(overlapHop, rateHop)));
+    }
+};
+
+/*
+ Turns the samples the left and right SingleChannelSampleFifos collect into spectrum paths.
+ process() runs on the AnalyzerThread, and the editor only ever picks up the newest paths it has finished.
+ */
 struct PathProducer
 {
-    PathProducer(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& scsf) :
-    leftChannelFifo(&scsf)
+    PathProducer(SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& leftScsf,
+                 SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>& rightScsf) :
+    leftChannelFifo(&leftScsf),
+    rightChannelFifo(&rightScsf)
     {
-        // Initialize the FFT Data Generator with the selected order
+        // Initialize the FFT Data Generator with the lowest order, process() switches to whatever the editor asks for
         // At order 2048, we get frequency bins that cover ~23hZ each
         // Of course we can get greater resolution with higher orders, but at the expense of greater CPU usage
-        leftChannelFFTDataGenerator.changeOrder(FFTOrder::order2048);
+        fftDataGenerator.changeOrder(FFTOrder::order2048);
         
-        // Initialize the monoBuffer with the proper size
-        monoBuffer.setSize(1,leftChannelFFTDataGenerator.getFFTSize());
+        // Initialize the stereoBuffer with the proper size
+        stereoBuffer.setSize(2, fftDataGenerator.getFFTSize());
+    }
+    
+    //called from the message thread whenever the analysis area or the sample rate might have changed
+    void setAnalysisSettings(const AnalyzerSettings& newSettings)
+    {
+        const juce::SpinLock::ScopedLockType lock(settingsLock);
+        analyzerSettings = newSettings;
     }
-    void process(juce::Rectangle<float> fftBounds, double sampleRate);
-    juce::Path getPath() { return leftChannelFFTPath; }
+    
+    void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+    bool isEnabled() const { return enabled; }
+    
+    /*
+     While its editor is idle, the next new paths trigger target, rather than waiting to be noticed by the editor's next poll.
+     Only one wake up is sent per request. Set the target before the producer is added to the AnalyzerThread,
+     and keep it alive until the producer has been removed.
+     */
+    void setWakeUpTarget(juce::AsyncUpdater* target) { wakeUpTarget = target; }
+    void setWakeUpRequested(bool shouldWakeUp) { wakeUpRequested = shouldWakeUp; }
+    
+    //only called on the AnalyzerThread. Returns true if there were new samples to analyze.
+    bool process();
+    
+    //message thread only. Swaps in the newest finished paths and returns true, if there are any we haven't seen yet.
+    bool updatePaths()
+    {
+        auto gotLeft = latestPaths[Channel::Left].acquire();
+        auto gotRight = latestPaths[Channel::Right].acquire();
+        return gotLeft || gotRight;
+    }
+    
+    const juce::Path& getPath(Channel channel) const { return latestPaths[channel].getReadBuffer(); }
 private:
     SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* leftChannelFifo;
+    SingleChannelSampleFifo<SimpleEQAudioProcessor::BlockType>* rightChannelFifo;
     
-    juce::AudioBuffer<float> monoBuffer;
+    //both channels' windows, numbered like Channel
+    juce::AudioBuffer<float> stereoBuffer;
     
-    FFTDataGenerator<std::vector<float>> leftChannelFFTDataGenerator;
+    FFTDataGenerator<std::vector<float>> fftDataGenerator;
     
-    AnalyzerPathGenerator<juce::Path> pathProducer;
+    //everything from here down is indexed by Channel
+    std::array<AnalyzerPathGenerator<juce::Path>, 2> pathGenerators;
     
-    juce::Path leftChannelFFTPath;
+    std::array<juce::Path, 2> fftPaths;
+    
+    juce::SpinLock settingsLock;
+    AnalyzerSettings analyzerSettings;
+    std::atomic<bool> enabled { true };
+    
+    /*
+     A full scale window can't put a bin more than 6 dB above its peak, so a window this quiet only ever draws the floor.
+     After the first of those, the following ones are skipped until there's something to see or the analyzer changes,
+     which leaves silence costing no FFTs and, since no new paths are published, no repaints.
+     */
+    static constexpr float silenceThresholdDecibels = -60.f;
+    bool lastWindowWasSilent = false;
+    juce::Rectangle<float> lastBounds;
+    
+    //the AnalyzerThread publishes finished paths here for the message thread
+    std::array<TripleBuffer<juce::Path>, 2> latestPaths;
+    
+    juce::AsyncUpdater* wakeUpTarget = nullptr;
+    std::atomic<bool> wakeUpRequested { false };
 };
 
+/*
+ Runs the analysis for every open editor on one background thread,
+ so the FFTs and the path building never hold up the message thread, however many editors are open.
+ 
+ The audio thread can't wake us up without taking a lock, so we look for new samples every few milliseconds instead.
+ A producer with nothing new to analyze returns straight away, so a pass with no new audio costs next to nothing.
+ While no new samples are arriving the passes back off to idlePollIntervalMs, and while no producer is enabled
+ there are no passes at all, until addProducer() or notify() wakes us. Call notify() after enabling a producer.
+ */
+struct AnalyzerThread : juce::Thread
+{
+    AnalyzerThread();
+    ~AnalyzerThread() override;
+    
+    // Once removeProducer() returns, the thread won't touch that producer again.
+    // It only ever waits for that producer's own pass, if one is running.
+    void addProducer(PathProducer& producer);
+    void removeProducer(PathProducer& producer);
+    
+    void run() override;
+private:
+    juce::CriticalSection producersLock;
+    juce::Array<PathProducer*> producers;
+    
+    //the producer whose process() is running right now, if any. Guarded by producersLock.
+    PathProducer* busyProducer = nullptr;
+    juce::WaitableEvent producerFinished;
+    
+    static constexpr int pollIntervalMs = 5, idlePollIntervalMs = 50;
+};
+
+/*
+ Redrawing is driven by the display's refresh through a VBlankAttachment, rather than by a timer of our own.
+ 
+ While nothing changes, that's still a callback per frame for nothing, which adds up with a lot of editors open.
+ So once there have been no new analyzer paths and no parameter changes for idleDelayMs,
+ or straight away when we can't be seen, the attachment is dropped and a slow timer only checks for activity.
+ The analyzer publishes nothing while the input is silent, so a stopped transport counts as idle too.
+ New analyzer paths, parameter changes from the message thread, the analyzer button, becoming visible
+ and being painted (which is how we find out that a minimised window has been restored) switch back to
+ following the display immediately. Parameter changes from other threads, like automation,
+ can't post a message from the audio thread, so those are noticed by the next idle check.
+ While we can't be seen at all, the analyzer isn't run either.
+ */
 struct ResponseCurveComponent : juce::Component,
 juce::AudioProcessorParameter::Listener,
-juce::Timer
+juce::Timer,
+juce::AsyncUpdater
 {
     ResponseCurveComponent(SimpleEQAudioProcessor&);
     ~ResponseCurveComponent();
@@ -257,26 +455,78 @@ juce::Timer
 
     void parameterGestureChanged (int parameterIndex, bool gestureIsStarting) override { };
 
+    //only runs while idle
     void timerCallback() override;
     
+    //something wants us to follow the display again
+    void handleAsyncUpdate() override;
+    
     void paint(juce::Graphics& g) override;
     
     void resized() override;
     
+    void visibilityChanged() override;
+    void parentHierarchyChanged() override;
+    
     void toggleAnalysisEnablement(bool enabled)
     {
         shouldShowFFTAnalysis = enabled;
+        
+        //either the paths appear again or they have to be wiped
+        repaintAnalyzer();
+        startActiveRefresh();
     }
     
 private:
     SimpleEQAudioProcessor& audioProcessor;
-    juce::Atomic<bool> parametersChanged { false };
+    std::atomic<float>* analyzerResolution { nullptr };
+    
+    //looked up once, so redesigning the curve doesn't search the apvts for every parameter
+    ChainParameters chainParameters;
+    
+    // The listener callbacks can arrive on any thread, so all they do is mark the sections they affect as dirty,
+    // the same way the processor does. parameterSections maps a parameter index to those sections.
+    std::vector<uint32_t> parameterSections;
+    std::atomic<uint32_t> dirtySections { 0 };
+    
+    ChainCoefficients chainCoefficients;
+    double designedSampleRate = 0;
+    
+    /*
+     The response curve only changes when a parameter or our size does, so everything that goes into it is kept.
+     frequencies holds the frequency under each pixel column of the analysis area,
+     and sectionMagnitudes the magnitude of each position in the chain at those frequencies, indexed by ChainPositions.
+     Moving a peak band only recalculates the peak magnitudes, the cut filters' stay as they are.
+     */
+    std::vector<double> frequencies;
+    MagnitudeResponse magnitudeResponse;
+    std::array<std::vector<double>, 3> sectionMagnitudes;
+    juce::Path responseCurve;
     
-    MonoChain monoChain;
+    /*
+     The background, the grid and the response curve only change with the size, the parameters or the display's scale,
+     so they're rendered together into staticLayer, at the scale paint() is drawing at.
+     paint() only has to copy that and stroke the analyzer paths over it, and the refresh only repaints
+     the part of the component the analyzer paths cover, when there are new ones.
+     An editor whose analyzer is switched off or has nothing new to show doesn't repaint at all.
+     */
+    juce::Image staticLayer;
+    float staticLayerScale = 0;
+    
+    //where the analyzer paths were last drawn, so their next repaint also covers the ones it replaces
+    juce::Rectangle<int> analyzerBounds;
+    
+    //renders the static layer again and repaints everything, for when the size or the curve has changed
+    void updateStaticLayer();
+    void renderStaticLayer(float scale);
+    void drawGrid(juce::Graphics& g);
+    void repaintAnalyzer();
     
-    void updateChain();
+    //redesigns the given ChainSections and brings the curve up to date with them
+    void updateChain(uint32_t sections);
     
-    juce::Image background;
+    //recalculates the magnitudes of the given ChainSections and rebuilds the path, or all of them if the width has changed
+    void updateResponseCurve(uint32_t sections);
     
     juce::Rectangle<int> getRenderArea();
     
@@ -284,9 +534,63 @@ private:
     // It is slightly smaller than the render area to allow space for our labels
     juce::Rectangle<int> getAnalysisArea();
     
-    PathProducer leftPathProducer, rightPathProducer;
+    PathProducer pathProducer;
+    
+    //shared by every editor in the process
+    juce::SharedResourcePointer<AnalyzerThread> analyzerThread;
+    
+    //no more spectra than this are worth drawing, however fast the display refreshes
+    static constexpr int maxSpectraPerSecond = 60;
+    static constexpr float analyzerOverlap = 0.5f;
     
     bool shouldShowFFTAnalysis = true;
+    
+    //only exists while we're following the display's refresh
+    std::unique_ptr<juce::VBlankAttachment> vBlankAttachment;
+    double lastActivityMs = 0;
+    
+    static constexpr int idleRateHz = 10;
+    static constexpr double idleDelayMs = 1000;
+    
+    void onVBlank();
+    void startActiveRefresh();
+    void startIdleRefresh();
+    
+    //hands the analyzer its settings and picks up anything new. Returns true if there was anything to redraw.
+    bool updateFrame();
+    
+    //false while we're hidden or our window is minimised
+    bool canBeSeen();
+    
+    //the analyzer only runs while it's switched on and can be seen
+    void updateAnalyzerEnablement();
+};
+
+/*
+ Shows how much of each block's time budget processBlock has been using,
+ so when a session drops out we can see straight away whether we're the ones to blame.
+ */
+struct ProcessLoadComponent : juce::Component, juce::Timer
+{
+    ProcessLoadComponent(SimpleEQAudioProcessor& p) : audioProcessor(p) { }
+    
+    void timerCallback() override;
+    
+    void paint(juce::Graphics& g) override;
+    
+    //the stats are only polled while they can be seen
+    void visibilityChanged() override;
+    void parentHierarchyChanged() override;
+private:
+    SimpleEQAudioProcessor& audioProcessor;
+    
+    // What's on screen. The stats change with every block, but mostly in digits that aren't shown,
+    // so it's only repainted when the text or its colour would change.
+    juce::String text;
+    bool overBudget = false;
+    
+    //fetches the stats and turns them into text, returns true if anything shown has changed
+    bool update();
 };
 
 //==============================================================================
@@ -337,14 +641,12 @@ private:
                         highCutSlopeSlider;
     
     ResponseCurveComponent responseCurveComponent;
+    ProcessLoadComponent processLoadComponent;
     
     using APVTS = juce::AudioProcessorValueTreeState;
     using Attachment = APVTS::SliderAttachment;
     
-    Attachment peakFreqSliderAttachment,
-                peakGainSliderAttachment,
-                peakQualitySliderAttachment,
-                lowCutFreqSliderAttachment,
+    Attachment lowCutFreqSliderAttachment,
                 highCutFreqSliderAttachment,
                 lowCutSlopeSliderAttachment,
                 highCutSlopeSliderAttachment;
@@ -352,14 +654,30 @@ private:
     PowerButton lowCutBypassButton, peakBypassButton, highCutBypassButton;
     AnalyzerButton analyzerEnabledButton;
     
+    //one set of peak controls is shared by all the bands, the band selector picks which one they're attached to
+    juce::ComboBox peakBandSelector, peakTypeSelector;
     
     using ButtonAttachment = APVTS::ButtonAttachment;
+    using ComboBoxAttachment = APVTS::ComboBoxAttachment;
     
     ButtonAttachment lowCutBypassButtonAttachment,
-                     peakBypassButtonAttachment,
                      highCutBypassButtonAttachment,
                      analyzerEnabledButtonAttachment;
     
+    std::unique_ptr<Attachment> peakFreqSliderAttachment,
+                                peakGainSliderAttachment,
+                                peakQualitySliderAttachment;
+    
+    std::unique_ptr<ButtonAttachment> peakBypassButtonAttachment;
+    std::unique_ptr<ComboBoxAttachment> peakTypeSelectorAttachment;
+    
+    //made once the selector has its items, otherwise the attachment has nothing to select
+    juce::ComboBox analyzerResolutionSelector;
+    std::unique_ptr<ComboBoxAttachment> analyzerResolutionSelectorAttachment;
+    
+    void selectPeakBand(int band);
+    void updatePeakControlsEnablement();
+    
     std::vector<juce::Component*> getComps();
     
     LookAndFeel lnf;
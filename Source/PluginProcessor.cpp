@@ -8,6 +8,7 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "RealtimeSafetyChecker.h"
 
 //==============================================================================
 SimpleEQAudioProcessor::SimpleEQAudioProcessor()
@@ -22,10 +23,32 @@ SimpleEQAudioProcessor::SimpleEQAudioProcessor()
                        )
 #endif
 {
+    const auto& params = getParameters();
+    for( auto* param : params )
+    {
+        auto sections = 0u;
+        if( auto* paramWithID = dynamic_cast<juce::AudioProcessorParameterWithID*>(param) )
+            sections = getSectionsForParameter(paramWithID->paramID);
+        
+        parameterSections.push_back(sections);
+        param->addListener(this);
+    }
+    
+    appliedPeakSlots.fill(-1);
+    
+    // Parameter changes are picked up here on the message thread, so processBlock never has to design filters.
+    startTimerHz(60);
 }
 
 SimpleEQAudioProcessor::~SimpleEQAudioProcessor()
 {
+    stopTimer();
+    
+    const auto& params = getParameters();
+    for( auto* param : params )
+    {
+        param->removeListener(this);
+    }
 }
 
 //==============================================================================
@@ -63,6 +86,12 @@ bool SimpleEQAudioProcessor::isMidiEffect() const
 
 double SimpleEQAudioProcessor::getTailLengthSeconds() const
 {
+    //the convolver keeps ringing for a whole kernel after the input stops
+    auto sampleRate = getSampleRate();
+    
+    if( chainParameters.linearPhase->load() > 0.5f && sampleRate > 0 )
+        return kernelBuilder.getKernelLength() / sampleRate;
+    
     return 0.0;
 }
 
@@ -97,14 +126,58 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
     // initialisation that you need..
     juce::dsp::ProcessSpec spec;
     spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
+    spec.numChannels = getTotalNumOutputChannels();
     spec.sampleRate = sampleRate;
     
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
+    filterChain.prepare(spec);
+    appliedPeakSlots.fill(-1);
+    
+    {
+        const juce::ScopedLock lock(channelWorkersLock);
+        channelWorkersBlockSize = samplesPerBlock;
+        channelWorkersSampleRate = sampleRate;
+        channelWorkersNumGroups = filterChain.getNumGroups();
+        
+        //the number of groups may have changed, so the workers are started again from scratch
+        channelWorkers.stop();
+        updateChannelWorkers();
+    }
+    
+    smoothers.reset(sampleRate, smoothingRampLengthInSeconds);
+    smoothingActive = false;
+    
+    processBlockTelemetry.prepare(sampleRate);
+    
+    // The kernel is sized to give FFT bins about 6 Hz apart whatever the sample rate,
+    // which is enough to follow the cut filters right down to 20 Hz
+    kernelBuilder.stopThread(1000);
+    kernelBuilder.prepare(sampleRate, juce::nextPowerOfTwo(juce::roundToInt(sampleRate / 6.0)), linearPhasePartitionSize);
+    linearPhaseConvolver.prepare((int)spec.numChannels, kernelBuilder.getPartitionSize(), kernelBuilder.getNumPartitions());
+    linearPhaseInput.setSize((int)spec.numChannels, samplesPerBlock);
+    linearPhaseKernelLoaded = false;
+    kernelBuilder.startThread();
     
     updateFilters();
     
+    // If linear phase mode is on, wait for its first kernel here, so it has one from the very first block
+    kernelBuilder.waitForPendingKernels();
+    if( kernelBuilder.acquireKernel() )
+    {
+        linearPhaseConvolver.loadKernel(kernelBuilder.getKernel(), false);
+        linearPhaseKernelLoaded = true;
+    }
+    
+    // Nothing is playing yet, so whichever mode is on can start straight away, there's nothing to switch from.
+    // Without a kernel, processBlock switches over as soon as one arrives.
+    const auto linearPhase = chainParameters.linearPhase->load() > 0.5f;
+    linearPhaseActive = linearPhaseRunning = linearPhase && linearPhaseKernelLoaded;
+    linearPhaseHeard = linearPhaseActive;
+    linearPhaseWarmup = 0;
+    linearPhaseSwitchGain.reset(sampleRate, linearPhaseSwitchSeconds);
+    linearPhaseSwitchGain.setCurrentAndTargetValue(1.f);
+    
+    setLatencySamples(getLatencyForMode(linearPhaseHeard));
+    
     // oscillator for checking accuracy of spectrum analyzer
 
     leftChannelFifo.prepare(samplesPerBlock);
@@ -112,8 +185,6 @@ void SimpleEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
 
     osc.initialise([](float x) {return std::sin(x); });
 
-    spec.numChannels = getTotalNumOutputChannels();
-
     osc.prepare(spec);  
     osc.setFrequency(500);
 }
@@ -122,6 +193,15 @@ void SimpleEQAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
+    {
+        const juce::ScopedLock lock(channelWorkersLock);
+        channelWorkersBlockSize = 0;
+        channelWorkersSampleRate = 0;
+        channelWorkersNumGroups = 0;
+        channelWorkers.stop();
+    }
+    
+    kernelBuilder.stopThread(1000);
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -131,12 +211,9 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Every channel goes through the same filters, so any layout will do:
+    // mono, stereo, surround, immersive or ambisonic.
+    if (layouts.getMainOutputChannelSet().isDisabled())
         return false;
 
     // This checks if the input layout matches the output layout
@@ -153,6 +230,13 @@ bool SimpleEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
 void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    ProcessBlockTelemetry::ScopedTimer processBlockTimer { processBlockTelemetry, buffer.getNumSamples() };
+
+   #if SIMPLEEQ_RT_CHECKS
+    //anything that allocates or locks from here on gets reported. Offline renders are allowed to wait for the filters.
+    RealtimeSafetyChecker::ScopedRealtimeThread realtimeScope { ! isNonRealtime() };
+   #endif
+
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -168,7 +252,26 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     // This is the place where you'd normally do the guts of your plugin's
     // audio processing...
     
-    updateFilters();
+    auto chainSettings = getChainSettings(chainParameters);
+    
+    // Offline renders can run much faster than the timer, so they design the coefficients right here,
+    // and wait for the linear phase kernel rather than letting the render depend on how fast the builder is.
+    if( isNonRealtime() )
+    {
+        if( auto sections = dirtySections.exchange(0) )
+            updateFilters(sections);
+        
+        if( chainSettings.linearPhase )
+        {
+            updateKernelRequests();
+            kernelBuilder.waitForPendingKernels();
+        }
+    }
+    
+    // All we do on the audio thread is pick up the newest coefficients, if there are any,
+    // and only copy the sections that were redesigned since we last looked.
+    if( coefficientBuffer.acquire() )
+        applyCoefficients(coefficientBuffer.getReadBuffer());
     
     juce::dsp::AudioBlock<float> block(buffer);
  
@@ -178,14 +281,42 @@ void SimpleEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
 //    juce::dsp::ProcessContextReplacing<float> stereoContext(block);
 //    osc.process(stereoContext);
     
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
+    auto subBlockSize = getSmoothingSubBlockSize(chainSettings.smoothing);
+    
+    // Looked at before the kernel is picked up. The builder publishes a kernel before it counts it as built,
+    // so if it's up to date now, the kernel for the current coefficients is already waiting in the TripleBuffer.
+    // While the mode is off nothing is being built, so whatever kernel we have is out of date.
+    auto kernelIsUpToDate = kernelFollowsCoefficients.load() && kernelBuilder.isUpToDate();
+    
+    // A new kernel has to wait until the previous one has finished fading in, it stays in the TripleBuffer till then.
+    // There's nothing to fade while the convolver isn't running, so then it's swapped in straight away.
+    if( ! linearPhaseConvolver.isFading() && kernelBuilder.acquireKernel() )
+    {
+        linearPhaseConvolver.loadKernel(kernelBuilder.getKernel(), linearPhaseRunning);
+        linearPhaseKernelLoaded = true;
+    }
     
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    updateLinearPhaseSwitch(chainSettings.linearPhase, kernelIsUpToDate);
     
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
+    if( ! linearPhaseRunning )
+    {
+        processMinimumPhase(block, chainSettings, subBlockSize);
+    }
+    else if( isOnlyLinearPhaseRunning() )
+    {
+        // The filters aren't running, so whatever their ramps were doing is over
+        if( smoothingActive )
+        {
+            applyCoefficients(coefficientBuffer.getReadBuffer(), ChainSections::AllSections);
+            smoothingActive = false;
+        }
+        
+        linearPhaseConvolver.process(block);
+    }
+    else
+    {
+        processLinearPhaseSwitch(block, chainSettings, subBlockSize);
+    }
     
     leftChannelFifo.update(buffer);
     rightChannelFifo.update(buffer);
@@ -225,88 +356,664 @@ void SimpleEQAudioProcessor::setStateInformation (const void* data, int sizeInBy
     }
 }
 
+ChainParameters::ChainParameters(juce::AudioProcessorValueTreeState& apvts) :
+lowCutFreq(apvts.getRawParameterValue("LowCut Freq")),
+highCutFreq(apvts.getRawParameterValue("HighCut Freq")),
+lowCutSlope(apvts.getRawParameterValue("LowCut Slope")),
+highCutSlope(apvts.getRawParameterValue("HighCut Slope")),
+lowCutBypassed(apvts.getRawParameterValue("LowCut Bypassed")),
+highCutBypassed(apvts.getRawParameterValue("HighCut Bypassed")),
+smoothing(apvts.getRawParameterValue("Smoothing")),
+parallelChannels(apvts.getRawParameterValue("Parallel Channels")),
+linearPhase(apvts.getRawParameterValue("Linear Phase"))
+{
+    for( int i = 0; i < NumPeakBands; ++i )
+    {
+        auto& band = peakBands[(size_t)i];
+        
+        band.freq = apvts.getRawParameterValue(getPeakParameterID(i, "Freq"));
+        band.gain = apvts.getRawParameterValue(getPeakParameterID(i, "Gain"));
+        band.quality = apvts.getRawParameterValue(getPeakParameterID(i, "Quality"));
+        band.type = apvts.getRawParameterValue(getPeakParameterID(i, "Type"));
+        band.bypassed = apvts.getRawParameterValue(getPeakParameterID(i, "Bypassed"));
+    }
+}
+
+juce::String getPeakParameterID(int band, const juce::String& name)
+{
+    if( band == 0 )
+        return "Peak " + name;
+    
+    return "Peak " + juce::String(band + 1) + " " + name;
+}
+
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+{
+    return getChainSettings(ChainParameters(apvts));
+}
+
+ChainSettings getChainSettings(const ChainParameters& chainParameters)
 {
     ChainSettings settings;
     
-    settings.lowCutFreq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.highCutFreq = apvts.getRawParameterValue("HighCut Freq")->load();
-    settings.peakFreq = apvts.getRawParameterValue("Peak Freq")->load();
-    settings.peakGainInDecibels = apvts.getRawParameterValue("Peak Gain")->load();
-    settings.peakQuality = apvts.getRawParameterValue("Peak Quality")->load();
-    settings.lowCutSlope = static_cast<Slope>(apvts.getRawParameterValue("LowCut Slope")->load());
-    settings.highCutSlope = static_cast<Slope>(apvts.getRawParameterValue("HighCut Slope")->load());
+    settings.lowCutFreq = chainParameters.lowCutFreq->load();
+    settings.highCutFreq = chainParameters.highCutFreq->load();
+    settings.lowCutSlope = static_cast<Slope>(chainParameters.lowCutSlope->load());
+    settings.highCutSlope = static_cast<Slope>(chainParameters.highCutSlope->load());
     
-    settings.lowCutBypassed = apvts.getRawParameterValue("LowCut Bypassed")->load() > 0.5f;
-    settings.highCutBypassed = apvts.getRawParameterValue("HighCut Bypassed")->load() > 0.5f;
-    settings.peakBypassed = apvts.getRawParameterValue("Peak Bypassed")->load() > 0.5f;
+    settings.lowCutBypassed = chainParameters.lowCutBypassed->load() > 0.5f;
+    settings.highCutBypassed = chainParameters.highCutBypassed->load() > 0.5f;
+    
+    for( size_t i = 0; i < settings.peakBands.size(); ++i )
+    {
+        const auto& params = chainParameters.peakBands[i];
+        auto& band = settings.peakBands[i];
+        
+        band.freq = params.freq->load();
+        band.gainInDecibels = params.gain->load();
+        band.quality = params.quality->load();
+        band.type = static_cast<BandType>(params.type->load());
+        band.bypassed = params.bypassed->load() > 0.5f;
+    }
+    
+    settings.smoothing = static_cast<SmoothingMode>(chainParameters.smoothing->load());
+    settings.parallelChannels = chainParameters.parallelChannels->load() > 0.5f;
+    settings.linearPhase = chainParameters.linearPhase->load() > 0.5f;
     
     return settings;
 }
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate)
+uint32_t getSectionsForParameter(const juce::String& parameterID)
 {
-    return juce::dsp::IIR::Coefficients<float>::makePeakFilter(sampleRate,
-                                                               chainSettings.peakFreq,
-                                                               chainSettings.peakQuality,
-                                                               juce::Decibels::decibelsToGain(chainSettings.peakGainInDecibels));
+    if( parameterID.startsWith("LowCut") )
+        return ChainSections::LowCutSection;
+    
+    //every band is part of the same cascade
+    if( parameterID.startsWith("Peak") )
+        return ChainSections::PeakSection;
+    
+    if( parameterID.startsWith("HighCut") )
+        return ChainSections::HighCutSection;
+    
+    return 0;
 }
 
-void SimpleEQAudioProcessor::updatePeakFilter(const ChainSettings &chainSettings)
+void SimpleEQAudioProcessor::updatePeakFilters(const PeakCoefficients& peaks)
 {
-    auto peakCoefficients = makePeakFilter(chainSettings, getSampleRate());
+    // When a band is switched on or off, the bands after it move to a different section of the cascade.
+    // Their filter state has to move with them, or they'd pick up another band's history and click.
+    std::array<int, NumPeakBands> previousSlots;
+    bool bandsMoved = false;
     
-    leftChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
-    rightChain.setBypassed<ChainPositions::Peak>(chainSettings.peakBypassed);
+    for( int s = 0; s < peaks.numActiveBands; ++s )
+    {
+        previousSlots[(size_t)s] = appliedPeakSlots[(size_t)peaks.bandIndices[(size_t)s]];
+        bandsMoved = bandsMoved || previousSlots[(size_t)s] != s;
+    }
+    
+    for( auto& chain : filterChain )
+    {
+        auto& peakFilter = chain.get<ChainPositions::Peak>();
+        
+        if( bandsMoved )
+            peakFilter.moveSectionStates(previousSlots.data(), peaks.numActiveBands);
+        
+        peakFilter.setCoefficients(peaks.bands.data(), peaks.numActiveBands);
+    }
+    
+    appliedPeakSlots.fill(-1);
+    for( int s = 0; s < peaks.numActiveBands; ++s )
+        appliedPeakSlots[(size_t)peaks.bandIndices[(size_t)s]] = s;
+}
+
+CutCoefficients makeLowCutCoefficients(const ChainSettings& chainSettings, double sampleRate)
+{
+    CutCoefficients lowCut;
+    
+    lowCut.slope = chainSettings.lowCutSlope;
+    lowCut.bypassed = chainSettings.lowCutBypassed;
+    
+    designButterworthHighPass(chainSettings.lowCutFreq, sampleRate, lowCut.getNumSections(), lowCut.sections.data());
+    
+    return lowCut;
+}
+
+CutCoefficients makeHighCutCoefficients(const ChainSettings& chainSettings, double sampleRate)
+{
+    CutCoefficients highCut;
+    
+    highCut.slope = chainSettings.highCutSlope;
+    highCut.bypassed = chainSettings.highCutBypassed;
     
-    updateCoefficients(leftChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
-    updateCoefficients(rightChain.get<ChainPositions::Peak>().coefficients, peakCoefficients);
+    designButterworthLowPass(chainSettings.highCutFreq, sampleRate, highCut.getNumSections(), highCut.sections.data());
+    
+    return highCut;
 }
 
-void updateCoefficients(Coefficients &old, const Coefficients &replacements)
+BiquadCoefficients makePeakBandCoefficients(const PeakBandSettings& band, double sampleRate)
 {
-    *old = *replacements;
+    auto gainFactor = juce::Decibels::decibelsToGain(band.gainInDecibels);
+    
+    switch( band.type )
+    {
+        case BandType_LowShelf:
+            return designLowShelf(sampleRate, band.freq, band.quality, gainFactor);
+        case BandType_HighShelf:
+            return designHighShelf(sampleRate, band.freq, band.quality, gainFactor);
+        case BandType_Peak:
+        default:
+            return designPeak(sampleRate, band.freq, band.quality, gainFactor);
+    }
 }
 
-void SimpleEQAudioProcessor::updateLowCutFilters(const ChainSettings &chainSettings)
+PeakCoefficients makePeakCoefficients(const ChainSettings& chainSettings, double sampleRate)
 {
-    auto cutCoefficients = makeLowCutFilter(chainSettings, getSampleRate());
-    auto& leftLowCut = leftChain.get<ChainPositions::LowCut>();
-    auto& rightLowCut = rightChain.get<ChainPositions::LowCut>();
+    PeakCoefficients peaks;
     
-    leftChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
-    rightChain.setBypassed<ChainPositions::LowCut>(chainSettings.lowCutBypassed);
+    for( int i = 0; i < NumPeakBands; ++i )
+    {
+        const auto& band = chainSettings.peakBands[(size_t)i];
+        
+        //a band at 0 dB is a straight wire whatever its type, so it doesn't need a section
+        if( band.bypassed || band.gainInDecibels == 0.f )
+            continue;
+        
+        auto slot = (size_t)peaks.numActiveBands++;
+        peaks.bands[slot] = makePeakBandCoefficients(band, sampleRate);
+        peaks.bandIndices[slot] = i;
+    }
     
-    updateCutFilter(leftLowCut,cutCoefficients,chainSettings.lowCutSlope);
-    updateCutFilter(rightLowCut, cutCoefficients, chainSettings.lowCutSlope);
+    return peaks;
 }
 
-void SimpleEQAudioProcessor::updateHighCutFilters(const ChainSettings &chainSettings)
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate)
 {
-    auto highCutCoefficients = makeHighCutFilter(chainSettings, getSampleRate());
-    auto& leftHighCut = leftChain.get<ChainPositions::HighCut>();
-    auto& rightHighCut = rightChain.get<ChainPositions::HighCut>();
+    ChainCoefficients chainCoefficients;
     
-    leftChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
-    rightChain.setBypassed<ChainPositions::HighCut>(chainSettings.highCutBypassed);
+    chainCoefficients.lowCut = makeLowCutCoefficients(chainSettings, sampleRate);
+    chainCoefficients.peaks = makePeakCoefficients(chainSettings, sampleRate);
+    chainCoefficients.highCut = makeHighCutCoefficients(chainSettings, sampleRate);
     
-    updateCutFilter(leftHighCut, highCutCoefficients, chainSettings.highCutSlope);
-    updateCutFilter(rightHighCut, highCutCoefficients, chainSettings.highCutSlope);
+    return chainCoefficients;
 }
 
-void SimpleEQAudioProcessor::updateFilters()
+double getMagnitudeForFrequency(const ChainCoefficients& chainCoefficients, double frequency, double sampleRate)
 {
-    auto chainSettings = getChainSettings(apvts);
+    double mag = 1.0;
+    
+    for( const auto* cut : { &chainCoefficients.lowCut, &chainCoefficients.highCut } )
+    {
+        if( cut->bypassed )
+            continue;
+        
+        for( int i = 0; i < cut->getNumSections(); ++i )
+            mag *= getMagnitudeForFrequency(cut->sections[(size_t)i], frequency, sampleRate);
+    }
+    
+    const auto& peaks = chainCoefficients.peaks;
+    for( int i = 0; i < peaks.numActiveBands; ++i )
+        mag *= getMagnitudeForFrequency(peaks.bands[(size_t)i], frequency, sampleRate);
     
-    updateLowCutFilters(chainSettings);
-    updatePeakFilter(chainSettings);
-    updateHighCutFilters(chainSettings);
+    return mag;
+}
+
+void getMagnitudes(const ChainCoefficients& chainCoefficients, MagnitudeResponse& response, double* magnitudes)
+{
+    //every section that isn't bypassed, gathered up so the whole chain is a single cascade
+    std::array<BiquadCoefficients, 8 + NumPeakBands> sections;
+    int numSections = 0;
+    
+    for( const auto* cut : { &chainCoefficients.lowCut, &chainCoefficients.highCut } )
+    {
+        if( cut->bypassed )
+            continue;
+        
+        for( int i = 0; i < cut->getNumSections(); ++i )
+            sections[(size_t)numSections++] = cut->sections[(size_t)i];
+    }
+    
+    const auto& peaks = chainCoefficients.peaks;
+    for( int i = 0; i < peaks.numActiveBands; ++i )
+        sections[(size_t)numSections++] = peaks.bands[(size_t)i];
+    
+    response.getMagnitudes(sections.data(), numSections, magnitudes);
+}
+
+void SimpleEQAudioProcessor::updateLowCutFilters(const CutCoefficients& lowCut)
+{
+    for( auto& chain : filterChain )
+    {
+        chain.setBypassed<ChainPositions::LowCut>(lowCut.bypassed);
+        chain.get<ChainPositions::LowCut>().setCoefficients(lowCut.sections.data(), lowCut.getNumSections());
+    }
+}
+
+void SimpleEQAudioProcessor::updateHighCutFilters(const CutCoefficients& highCut)
+{
+    for( auto& chain : filterChain )
+    {
+        chain.setBypassed<ChainPositions::HighCut>(highCut.bypassed);
+        chain.get<ChainPositions::HighCut>().setCoefficients(highCut.sections.data(), highCut.getNumSections());
+    }
+}
+
+void SimpleEQAudioProcessor::applyCoefficients(const ChainCoefficients& chainCoefficients, uint32_t sectionsToForce)
+{
+    const auto& versions = chainCoefficients.versions;
+    
+    if( versions[ChainPositions::LowCut] != appliedVersions[ChainPositions::LowCut] || (sectionsToForce & ChainSections::LowCutSection) )
+        updateLowCutFilters(chainCoefficients.lowCut);
+    
+    if( versions[ChainPositions::Peak] != appliedVersions[ChainPositions::Peak] || (sectionsToForce & ChainSections::PeakSection) )
+        updatePeakFilters(chainCoefficients.peaks);
+    
+    if( versions[ChainPositions::HighCut] != appliedVersions[ChainPositions::HighCut] || (sectionsToForce & ChainSections::HighCutSection) )
+        updateHighCutFilters(chainCoefficients.highCut);
+    
+    appliedVersions = versions;
+}
+
+void SimpleEQAudioProcessor::processMinimumPhase(const juce::dsp::AudioBlock<float>& block,
+                                                 const ChainSettings& settings,
+                                                 int subBlockSize)
+{
+    if( subBlockSize > 0 )
+    {
+        processWithSmoothing(block, settings, subBlockSize);
+        return;
+    }
+    
+    // If smoothing was switched off halfway through a ramp, put the published coefficients back
+    if( smoothingActive )
+    {
+        applyCoefficients(coefficientBuffer.getReadBuffer(), ChainSections::AllSections);
+        smoothingActive = false;
+    }
+    
+    // The channels run through the filters together, one per SIMD lane
+    filterChain.process(block, getChannelWorkers(settings));
+}
+
+void SimpleEQAudioProcessor::updateLinearPhaseSwitch(bool linearPhase, bool kernelIsUpToDate)
+{
+    if( linearPhase == linearPhaseActive )
+        return;
+    
+    if( linearPhase )
+    {
+        //the filters carry on until there's a kernel that matches them
+        if( ! linearPhaseKernelLoaded || ! kernelIsUpToDate )
+            return;
+        
+        linearPhaseActive = true;
+        
+        // If it's still running it hasn't been faded out completely yet, so it's warmed up
+        // and processLinearPhaseSwitch just turns the fade around.
+        // Otherwise the convolver starts from silence, so it's fed the input alongside the filters
+        // until the whole kernel has samples to work on, and only then do the filters fade out.
+        if( ! linearPhaseRunning )
+        {
+            linearPhaseConvolver.reset();
+            linearPhaseRunning = true;
+            linearPhaseWarmup = 2 * kernelBuilder.getLatencySamples() + linearPhaseConvolver.getLatencySamples();
+        }
+    }
+    else
+    {
+        linearPhaseActive = false;
+        
+        //never heard, so there's nothing to fade out
+        if( linearPhaseWarmup > 0 )
+        {
+            linearPhaseWarmup = 0;
+            linearPhaseRunning = false;
+            return;
+        }
+        
+        //the filters haven't been running, so they start from silence rather than whatever they held
+        if( isOnlyLinearPhaseRunning() )
+            filterChain.reset();
+    }
+}
+
+void SimpleEQAudioProcessor::processLinearPhaseSwitch(const juce::dsp::AudioBlock<float>& block,
+                                                      const ChainSettings& settings,
+                                                      int subBlockSize)
+{
+    const auto maxChunkSize = (size_t)linearPhaseInput.getNumSamples();
+    const auto numSamples = block.getNumSamples();
+    const auto numChannels = juce::jmin(block.getNumChannels(), (size_t)linearPhaseInput.getNumChannels());
+    
+    if( maxChunkSize == 0 )
+        return;
+    
+    // The convolver works on a copy of the input while the filters work on the block itself,
+    // a chunk at a time in case the host sends more than it promised in prepareToPlay
+    for( size_t start = 0; start < numSamples; start += maxChunkSize )
+    {
+        const auto length = juce::jmin(maxChunkSize, numSamples - start);
+        
+        auto output = block.getSubBlock(start, length);
+        auto convolved = juce::dsp::AudioBlock<float>(linearPhaseInput).getSubsetChannelBlock(0, numChannels).getSubBlock(0, length);
+        
+        convolved.copyFrom(output);
+        linearPhaseConvolver.process(convolved);
+        processMinimumPhase(output, settings, subBlockSize);
+        
+        for( size_t i = 0; i < length; ++i )
+        {
+            if( linearPhaseWarmup > 0 )
+            {
+                --linearPhaseWarmup;
+            }
+            else
+            {
+                //the path being heard fades out if it's not the one we want, and back in if it is
+                auto target = linearPhaseHeard == linearPhaseActive ? 1.f : 0.f;
+                
+                if( linearPhaseSwitchGain.getTargetValue() != target )
+                    linearPhaseSwitchGain.setTargetValue(target);
+            }
+            
+            auto gain = linearPhaseSwitchGain.getNextValue();
+            
+            //silent, so the other path can take over, with its own latency
+            if( gain == 0.f && linearPhaseHeard != linearPhaseActive )
+            {
+                linearPhaseHeard = linearPhaseActive;
+                setLatencySamples(getLatencyForMode(linearPhaseHeard));
+            }
+            
+            for( size_t channel = 0; channel < numChannels; ++channel )
+            {
+                auto& sample = output.getChannelPointer(channel)[i];
+                sample = gain * (linearPhaseHeard ? convolved.getChannelPointer(channel)[i] : sample);
+            }
+        }
+    }
+    
+    //faded back in on the filters, so the convolver can stop
+    if( ! linearPhaseActive && ! linearPhaseHeard && ! linearPhaseSwitchGain.isSmoothing() )
+        linearPhaseRunning = false;
+}
+
+void SimpleEQAudioProcessor::processWithSmoothing(const juce::dsp::AudioBlock<float>& block,
+                                                  ChainSettings settings,
+                                                  int subBlockSize)
+{
+    // The targets come straight from the parameters rather than from the timer,
+    // so automation starts ramping in the very block it arrives in.
+    if( smoothingActive )
+    {
+        smoothers.setTargetValues(settings);
+    }
+    else
+    {
+        smoothers.setCurrentAndTargetValues(settings);
+        smoothingActive = true;
+    }
+    
+    auto* workers = getChannelWorkers(settings);
+    
+    if( smoothers.getSmoothingSections() == 0 )
+    {
+        filterChain.process(block, workers);
+        return;
+    }
+    
+    const auto sampleRate = getSampleRate();
+    const auto numSamples = block.getNumSamples();
+    
+    for( size_t start = 0; start < numSamples; start += (size_t)subBlockSize )
+    {
+        auto length = juce::jmin((size_t)subBlockSize, numSamples - start);
+        auto sections = smoothers.getSmoothingSections();
+        
+        // Design for where the ramps are at the end of the sub-block,
+        // that way the last sub-block of a ramp lands exactly on the target.
+        smoothers.skip((int)length, settings);
+        
+        if( sections & ChainSections::LowCutSection )
+            updateLowCutFilters(makeLowCutCoefficients(settings, sampleRate));
+        
+        if( sections & ChainSections::PeakSection )
+            updatePeakFilters(makePeakCoefficients(settings, sampleRate));
+        
+        if( sections & ChainSections::HighCutSection )
+            updateHighCutFilters(makeHighCutCoefficients(settings, sampleRate));
+        
+        filterChain.process(block.getSubBlock(start, length), workers);
+    }
+}
+
+void SimpleEQAudioProcessor::updateFilters(uint32_t sections)
+{
+    auto sampleRate = getSampleRate();
+    
+    //nothing to design for until prepareToPlay has told us the sample rate
+    if( sampleRate <= 0 )
+        return;
+    
+    auto chainSettings = getChainSettings(chainParameters);
+    
+    const juce::ScopedLock lock(designLock);
+    
+    if( sections & ChainSections::LowCutSection )
+    {
+        designedCoefficients.lowCut = makeLowCutCoefficients(chainSettings, sampleRate);
+        ++designedCoefficients.versions[ChainPositions::LowCut];
+    }
+    
+    if( sections & ChainSections::PeakSection )
+    {
+        designedCoefficients.peaks = makePeakCoefficients(chainSettings, sampleRate);
+        ++designedCoefficients.versions[ChainPositions::Peak];
+    }
+    
+    if( sections & ChainSections::HighCutSection )
+    {
+        designedCoefficients.highCut = makeHighCutCoefficients(chainSettings, sampleRate);
+        ++designedCoefficients.versions[ChainPositions::HighCut];
+    }
+    
+    coefficientBuffer.getWriteBuffer() = designedCoefficients;
+    coefficientBuffer.publish();
+    
+    // Building a kernel takes a few big FFTs, which isn't worth doing for every knob move while nobody's listening to it
+    // The request goes in before kernelFollowsCoefficients is set, so once the audio thread sees that,
+    // isUpToDate() already counts the request
+    auto linearPhase = chainParameters.linearPhase->load() > 0.5f;
+    if( linearPhase )
+        kernelBuilder.requestKernel(designedCoefficients);
+    
+    kernelFollowsCoefficients = linearPhase;
+}
+
+void SimpleEQAudioProcessor::updateKernelRequests()
+{
+    const juce::ScopedLock lock(designLock);
+    
+    auto linearPhase = chainParameters.linearPhase->load() > 0.5f;
+    
+    //the kernel stopped following the coefficients while the mode was off, so it's caught up in one go
+    if( linearPhase && ! kernelFollowsCoefficients && getSampleRate() > 0 )
+        kernelBuilder.requestKernel(designedCoefficients);
+    
+    kernelFollowsCoefficients = linearPhase;
+}
+
+int SimpleEQAudioProcessor::getLatencyForMode(bool linearPhase) const
+{
+    if( ! linearPhase )
+        return 0;
+    
+    return kernelBuilder.getLatencySamples() + linearPhaseConvolver.getLatencySamples();
+}
+
+void LinearPhaseKernelBuilder::prepare(double newSampleRate, int kernelLength, int partitionSize)
+{
+    jassert(! isThreadRunning());
+    
+    sampleRate = newSampleRate;
+    designer.prepare(kernelLength, partitionSize);
+    
+    std::vector<double> binFrequencies;
+    for( int bin = 0; bin < designer.getNumBins(); ++bin )
+        binFrequencies.push_back(designer.getBinFrequency(bin, sampleRate));
+    
+    binResponse.prepare(binFrequencies.data(), (int)binFrequencies.size(), sampleRate);
+    binMagnitudes.assign(binFrequencies.size(), 1.0);
+    
+    kernels.prepare([this](PartitionedKernel& kernel)
+    {
+        kernel.prepare(designer.getPartitionSize(), designer.getNumPartitions());
+    });
+    
+    const juce::ScopedLock lock(requestLock);
+    requestedGeneration = 0;
+    builtGeneration = 0;
+}
+
+void LinearPhaseKernelBuilder::requestKernel(const ChainCoefficients& chainCoefficients)
+{
+    {
+        const juce::ScopedLock lock(requestLock);
+        requestedCoefficients = chainCoefficients;
+        ++requestedGeneration;
+    }
+    
+    notify();
+}
+
+void LinearPhaseKernelBuilder::waitForPendingKernels()
+{
+    uint32_t generation = 0;
+    
+    {
+        const juce::ScopedLock lock(requestLock);
+        generation = requestedGeneration;
+    }
+    
+    while( builtGeneration.load() != generation && isThreadRunning() )
+        kernelBuilt.wait(10);
+}
+
+void LinearPhaseKernelBuilder::run()
+{
+    while( ! threadShouldExit() )
+    {
+        ChainCoefficients chainCoefficients;
+        uint32_t generation = 0;
+        
+        {
+            const juce::ScopedLock lock(requestLock);
+            chainCoefficients = requestedCoefficients;
+            generation = requestedGeneration;
+        }
+        
+        //nothing new to build, so sleep until requestKernel() wakes us up
+        if( generation == builtGeneration.load() )
+        {
+            wait(-1);
+            continue;
+        }
+        
+        // The same magnitudes the response curve draws, so what you see is what you get
+        getMagnitudes(chainCoefficients, binResponse, binMagnitudes.data());
+        designer.design(binMagnitudes.data(), kernels.getWriteBuffer());
+        
+        kernels.publish();
+        
+        builtGeneration.store(generation);
+        kernelBuilt.signal();
+    }
+}
+
+void SimpleEQAudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    if( juce::isPositiveAndBelow(parameterIndex, (int)parameterSections.size()) )
+        dirtySections.fetch_or(parameterSections[(size_t)parameterIndex]);
+}
+
+void SimpleEQAudioProcessor::audioWorkgroupContextChanged(const juce::AudioWorkgroup& workgroup)
+{
+    channelWorkers.setWorkgroup(workgroup);
+}
+
+void SimpleEQAudioProcessor::updateChannelWorkers()
+{
+    const juce::ScopedLock lock(channelWorkersLock);
+    
+    // The calling thread always takes a share of the groups itself, so we need one worker less than there are groups
+    auto numWorkers = 0;
+    if( chainParameters.parallelChannels->load() > 0.5f && channelWorkersBlockSize > 0 )
+        numWorkers = juce::jmax(0, juce::jmin(channelWorkersNumGroups - 1, juce::SystemStats::getNumCpus() - 1));
+    
+    if( numWorkers == channelWorkers.getNumWorkers() )
+        return;
+    
+    if( numWorkers > 0 )
+        channelWorkers.start(numWorkers, channelWorkersBlockSize, channelWorkersSampleRate);
+    else
+        channelWorkers.stop();
+}
+
+void SimpleEQAudioProcessor::timerCallback()
+{
+    //most of the time nothing has moved, so there's nothing to do
+    if( auto sections = dirtySections.exchange(0) )
+        updateFilters(sections);
+    
+    //the audio thread can't start threads, so the workers follow Parallel Channels from here
+    updateChannelWorkers();
+    
+    //and the kernel builder follows Linear Phase
+    updateKernelRequests();
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::createParameterLayout()
 {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
     
+    // Hosts and wrappers that address parameters by index (VST2, AU without legacy IDs) store automation against
+    // the position of each parameter, so the original parameters keep their places and everything newer goes after them.
+    // The peak bands all share the same ranges, these make sure of it.
+    auto makePeakFreq = [](const juce::String& id, float defaultFreq)
+    {
+        return std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {id, 1},
+                                                           id,
+                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
+                                                           defaultFreq);
+    };
+    
+    auto makePeakGain = [](const juce::String& id)
+    {
+        return std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {id, 1},
+                                                           id,
+                                                           juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f),
+                                                           0.0f);
+    };
+    
+    auto makePeakQuality = [](const juce::String& id)
+    {
+        return std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {id, 1},
+                                                           id,
+                                                           juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
+                                                           1.f);
+    };
+    
+    juce::StringArray bandTypes { "Peak", "Low Shelf", "High Shelf" };
+    
+    auto makePeakType = [&bandTypes](const juce::String& id)
+    {
+        return std::make_unique<juce::AudioParameterChoice>(juce::ParameterID {id, 1}, id, bandTypes, 0);
+    };
+    
+    auto makePeakBypassed = [](const juce::String& id)
+    {
+        return std::make_unique<juce::AudioParameterBool>(juce::ParameterID {id, 1}, id, false);
+    };
+    
     layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {"LowCut Freq", 1},
                                                           "LowCut Freq",
                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
@@ -317,20 +1024,10 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::crea
                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
                                                           20000.f));
     
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {"Peak Freq", 1},
-                                                          "Peak Freq",
-                                                          juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
-                                                          750.f));
-    
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {"Peak Gain", 1},
-                                                          "Peak Gain",
-                                                          juce::NormalisableRange<float>(-24.f, 24.f, 0.5f, 1.f),
-                                                          0.0f));
-    
-    layout.add(std::make_unique<juce::AudioParameterFloat>(juce::ParameterID {"Peak Quality", 1},
-                                                          "Peak Quality",
-                                                          juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
-                                                          1.f));
+    //the first band is the original peak filter
+    layout.add(makePeakFreq(getPeakParameterID(0, "Freq"), 750.f));
+    layout.add(makePeakGain(getPeakParameterID(0, "Gain")));
+    layout.add(makePeakQuality(getPeakParameterID(0, "Quality")));
     
     juce::StringArray stringArray;
     for (int i = 0; i < 4; ++i){
@@ -345,9 +1042,47 @@ juce::AudioProcessorValueTreeState::ParameterLayout SimpleEQAudioProcessor::crea
     
     layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID {"LowCut Bypassed", 1}, "LowCut Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID {"HighCut Bypassed", 1}, "HighCut Bypassed", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID {"Peak Bypassed", 1}, "Peak Bypassed", false));
+    layout.add(makePeakBypassed(getPeakParameterID(0, "Bypassed")));
     layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID {"Analyzer Enabled", 1}, "Analyzer Enabled", true));
     
+    //everything from here on was added later
+    layout.add(makePeakType(getPeakParameterID(0, "Type")));
+    
+    for( int band = 1; band < NumPeakBands; ++band )
+    {
+        //the new bands start spread out evenly across the spectrum
+        auto defaultFreq = std::round(juce::mapToLog10((band + 0.5f) / NumPeakBands, 20.f, 20000.f));
+        
+        layout.add(makePeakFreq(getPeakParameterID(band, "Freq"), defaultFreq));
+        layout.add(makePeakGain(getPeakParameterID(band, "Gain")));
+        layout.add(makePeakQuality(getPeakParameterID(band, "Quality")));
+        layout.add(makePeakType(getPeakParameterID(band, "Type")));
+        layout.add(makePeakBypassed(getPeakParameterID(band, "Bypassed")));
+    }
+    
+    juce::StringArray smoothingChoices { "Off" };
+    for( auto mode : { Smoothing_16, Smoothing_32, Smoothing_64 } )
+    {
+        juce::String str;
+        str << getSmoothingSubBlockSize(mode);
+        str << " Samples";
+        smoothingChoices.add(str);
+    }
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID {"Smoothing", 1}, "Smoothing", smoothingChoices, 0));
+    
+    //only makes a difference on layouts with more channels than fit in one SIMD register
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID {"Parallel Channels", 1}, "Parallel Channels", false));
+    
+    //runs the whole chain as one linear phase FIR, at the cost of latency
+    layout.add(std::make_unique<juce::AudioParameterBool>(juce::ParameterID {"Linear Phase", 1}, "Linear Phase", false));
+    
+    //the analyzer's FFT size. The choices line up with FFTOrder, starting from order2048.
+    layout.add(std::make_unique<juce::AudioParameterChoice>(juce::ParameterID {"Analyzer Resolution", 1},
+                                                            "Analyzer Resolution",
+                                                            juce::StringArray { "2048", "4096", "8192" },
+                                                            0));
+    
     return layout;
 }
 
@@ -10,14 +10,25 @@
 
 #include <JuceHeader.h>
 
+#include "BiquadCascade.h"
+#include "CoefficientDesign.h"
+#include "MagnitudeResponse.h"
+#include "PartitionedConvolver.h"
+#include "ProcessBlockTelemetry.h"
+#include "RealtimeWorkerPool.h"
+
 #include <array>
+#include <atomic>
 
 /*
- While the SingleChannelSampleFifo is collecting individual samples from the buffers into blocks,
- we need a FIFO for our GUI to retrieve the blocks that the SingleChannelSampleFifo has produced.
+ The analyzer hands its FFT data and paths from one stage to the next through this Fifo.
  
- This Fifo takes care of that for us.
- The SingleChannelSampleFifo also inherits from this base class.
+ Copying whole objects in and out would mean a deep copy at every hand-off, and maybe an allocation,
+ so the slots can be used in place instead:
+ the writer fills the slot beginWrite() gives it and publishes it with finishWrite(),
+ and the reader borrows the oldest slot with beginRead() and hands it back with finishRead().
+ pushBySwap() and pullBySwap() trade objects with a slot, which for vectors and paths only swaps pointers.
+ push() and pull() still copy, for when that's what you want.
  */
 template<typename T>
 struct Fifo
@@ -48,12 +59,47 @@ struct Fifo
         }
     }
     
+    //returns the slot to write into, or nullptr if the fifo is full. It still holds whatever was written there last time.
+    T* beginWrite()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite(1, start1, size1, start2, size2);
+        return size1 > 0 ? &buffers[(size_t)start1] : nullptr;
+    }
+    
+    //publishes the slot from beginWrite()
+    void finishWrite() { fifo.finishedWrite(1); }
+    
+    //returns the oldest slot that hasn't been read yet, or nullptr if there isn't one. It stays ours until finishRead().
+    T* beginRead()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+        return size1 > 0 ? &buffers[(size_t)start1] : nullptr;
+    }
+    
+    //gives the slot from beginRead() back to the writer
+    void finishRead() { fifo.finishedRead(1); }
+    
     bool push(const T& t)
     {
-        auto write = fifo.write(1);
-        if( write.blockSize1 > 0 )
+        if( auto* slot = beginWrite() )
+        {
+            *slot = t;
+            finishWrite();
+            return true;
+        }
+        
+        return false;
+    }
+    
+    //t gets whatever the slot held before, so its storage can be reused for the next push
+    bool pushBySwap(T& t)
+    {
+        if( auto* slot = beginWrite() )
         {
-            buffers[write.startIndex1] = t;
+            std::swap(*slot, t);
+            finishWrite();
             return true;
         }
         
@@ -62,10 +108,23 @@ struct Fifo
     
     bool pull(T& t)
     {
-        auto read = fifo.read(1);
-        if( read.blockSize1 > 0 )
+        if( auto* slot = beginRead() )
         {
-            t = buffers[read.startIndex1];
+            t = *slot;
+            finishRead();
+            return true;
+        }
+        
+        return false;
+    }
+    
+    //the slot gets t's old contents, so the writer can reuse their storage
+    bool pullBySwap(T& t)
+    {
+        if( auto* slot = beginRead() )
+        {
+            std::swap(*slot, t);
+            finishRead();
             return true;
         }
         
@@ -82,6 +141,70 @@ private:
     juce::AbstractFifo fifo {Capacity};
 };
 
+/*
+ The audio thread must never wait on whoever designs the filter coefficients.
+ 
+ The TripleBuffer lets a single writer hand complete objects to a single reader without either side blocking.
+ The writer fills its private back buffer and swaps it into the middle slot when it publishes.
+ The reader swaps the middle slot with its front buffer whenever something new has been published,
+ so it always ends up holding the most recent object and never sees one that is half written.
+ */
+template<typename T>
+struct TripleBuffer
+{
+    /*
+     Calls function on all three buffers, e.g. to size them, and forgets anything that was published.
+     Only safe while neither the writer nor the reader is using the TripleBuffer.
+     */
+    template<typename Function>
+    void prepare(Function&& function)
+    {
+        for( auto& buffer : buffers )
+            function(buffer);
+        
+        middle.store(middle.load() & indexMask);
+    }
+    
+    //the back buffer holds stale data, so the writer should overwrite all of it before publishing
+    T& getWriteBuffer() { return buffers[backIndex]; }
+    
+    void publish()
+    {
+        backIndex = middle.exchange(backIndex | newDataFlag, std::memory_order_acq_rel) & indexMask;
+    }
+    
+    //returns true if a newer object was swapped into the front buffer
+    bool acquire()
+    {
+        if( (middle.load(std::memory_order_relaxed) & newDataFlag) == 0 )
+            return false;
+        
+        frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+    
+    const T& getReadBuffer() const { return buffers[frontIndex]; }
+    
+    //the reader may swap the front buffer's contents out, it goes back to the writer as stale data anyway
+    T& getReadBuffer() { return buffers[frontIndex]; }
+private:
+    static constexpr int indexMask = 3;
+    static constexpr int newDataFlag = 4;
+    
+    std::array<T, 3> buffers;
+    std::atomic<int> middle { 1 };
+    int backIndex = 0;
+    int frontIndex = 2;
+};
+
+//the analyzer's FFT sizes
+enum FFTOrder
+{
+    order2048 = 11,
+    order4096 = 12,
+    order8192 = 13
+};
+
 enum Channel
 {
     Right, //effectively 0
@@ -93,13 +216,25 @@ enum Channel
  The host passes in buffers which have a variety of different sizes.
  We need a way to collect them into blocks of fixed sizes.
  
- The SingleChannelSampleFifo class takes care of this for us.
- It inherits from the Fifo class above.
+ The SingleChannelSampleFifo keeps the most recent samples of one channel in a ring buffer.
+ The audio thread writes each block in with at most two bulk copies (two only when it wraps around the end),
+ and the reader takes the samples back out in whatever sized pieces suit it.
+ 
+ There's one writer, the audio thread, which only ever moves the write position,
+ and one reader, which only ever moves its read position, so neither side waits on the other.
+ If the reader falls so far behind that the writer laps it, the oldest samples are lost
+ and the reader skips ahead to the ones that are still there.
+ 
+ The reader runs on its own thread, while prepare() runs whenever the host calls prepareToPlay,
+ so the reader holds getReaderLock() for as long as it's reading, and prepare() waits for it before touching the ring.
+ The audio thread never takes the lock, the host doesn't call prepareToPlay while it's processing anyway.
  */
-
 template<typename BlockType>
 struct SingleChannelSampleFifo
 {
+    //the longest window the reader will ever ask for, one FFT at the analyzer's highest resolution
+    static constexpr int maxWindowSize = 1 << FFTOrder::order8192;
+    
     SingleChannelSampleFifo(Channel ch) : channelToUse(ch)
     {
         prepared.set(false);
@@ -108,56 +243,145 @@ struct SingleChannelSampleFifo
     void update(const BlockType& buffer)
     {
         jassert(prepared.get());
-        jassert(buffer.getNumChannels() > channelToUse );
-        auto* channelPtr = buffer.getReadPointer(channelToUse);
+        jassert(buffer.getNumChannels() > 0);
+        
+        //on a mono bus both analyzers show the only channel there is
+        auto channel = juce::jmin(static_cast<int>(channelToUse), buffer.getNumChannels() - 1);
+        auto* channelPtr = buffer.getReadPointer(channel);
         
-        for( int i = 0; i < buffer.getNumSamples(); ++i )
+        // The reader trusts that nothing more than one prepared block size is being written past the write position,
+        // so a host that sends a bigger block than it promised gets it written in pieces
+        for( int done = 0; done < buffer.getNumSamples(); )
         {
-            pushNextSampleIntoFifo(channelPtr[i]);
+            auto count = juce::jmin(buffer.getNumSamples() - done, size.get());
+            write(channelPtr + done, count);
+            done += count;
         }
     }
 
+    //allocates, so only call this while the audio thread isn't using the fifo. The reader is locked out until it's done.
     void prepare(int bufferSize)
     {
+        const juce::SpinLock::ScopedLockType lock(readerLock);
+        
         prepared.set(false);
-        size.set(bufferSize);
-        
-        bufferToFill.setSize(1,             //channel
-                             bufferSize,    //num samples
-                             false,         //keepExistingContent
-                             true,          //clear extra space
-                             true);         //avoid reallocating
-        audioBufferFifo.prepare(1, bufferSize);
-        fifoIndex = 0;
+        size.set(juce::jmax(1, bufferSize));
+        
+        // Room for the longest window plus the block being written,
+        // and a few more blocks so a reader that's a frame late doesn't lose anything
+        auto capacity = juce::nextPowerOfTwo(maxWindowSize + 4 * size.get());
+        ring.assign((size_t)capacity, 0.f);
+        mask = (uint64_t)capacity - 1;
+        
+        writePosition.store(0);
+        readPosition = 0;
         prepared.set(true);
     }
     //==============================================================================
-    int getNumCompleteBuffersAvailable() const { return audioBufferFifo.getNumAvailableForReading(); }
     bool isPrepared() const { return prepared.get(); }
     int getSize() const { return size.get(); }
+    
+    //the reader has to hold this while it calls anything below, a ScopedTryLockType lets it skip a pass rather than wait
+    juce::SpinLock& getReaderLock() { return readerLock; }
+    
+    //how far back the reader can go. The rest of the ring is kept free for the block that's being written.
+    int getHistorySize() const { return (int)ring.size() - size.get(); }
+    
+    //how many samples have arrived that the reader hasn't read yet
+    int getNumSamplesAvailable() const
+    {
+        return (int)juce::jmin(writePosition.load(std::memory_order_acquire) - readPosition, (uint64_t)getHistorySize());
+    }
     //==============================================================================
-    bool getAudioBuffer(BlockType& buf) { return audioBufferFifo.pull(buf); }
+    /*
+     Copies the next numSamples unread samples into dest, oldest first.
+     Returns how many there were, which is less than numSamples if not enough have arrived yet.
+     */
+    int read(float* dest, int numSamples)
+    {
+        uint64_t count = 0;
+        
+        for( ;; )
+        {
+            auto end = writePosition.load(std::memory_order_acquire);
+            
+            if( end - readPosition > (uint64_t)getHistorySize() )
+                readPosition = end - (uint64_t)getHistorySize();
+            
+            count = juce::jmin((uint64_t)juce::jmax(0, numSamples), end - readPosition);
+            copyFrom(readPosition, dest, (int)count);
+            
+            // If the writer lapped us while we were copying, what we copied is no good, so go again from further ahead.
+            // The fence keeps the copy from being moved after the load that checks it.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            
+            if( writePosition.load(std::memory_order_relaxed) - readPosition <= (uint64_t)getHistorySize() )
+                break;
+        }
+        
+        readPosition += count;
+        return (int)count;
+    }
+    
+    /*
+     Copies the most recent numSamples samples into dest, oldest first, and marks everything up to now as read.
+     Returns false if fewer than numSamples have ever been written.
+     */
+    bool readLatest(float* dest, int numSamples)
+    {
+        jassert(numSamples <= getHistorySize());
+        
+        for( ;; )
+        {
+            auto end = writePosition.load(std::memory_order_acquire);
+            if( end < (uint64_t)numSamples )
+                return false;
+            
+            copyFrom(end - (uint64_t)numSamples, dest, numSamples);
+            
+            //the same check as read()
+            std::atomic_thread_fence(std::memory_order_acquire);
+            
+            if( writePosition.load(std::memory_order_relaxed) - (end - (uint64_t)numSamples) <= (uint64_t)getHistorySize() )
+            {
+                readPosition = end;
+                return true;
+            }
+        }
+    }
 private:
     Channel channelToUse;
-    int fifoIndex = 0;
-    Fifo<BlockType> audioBufferFifo;
-    BlockType bufferToFill;
+    std::vector<float> ring;
+    uint64_t mask = 0;
+    
+    //counts every sample ever written or read, so they never wrap around
+    std::atomic<uint64_t> writePosition { 0 };
+    uint64_t readPosition = 0;
+    
     juce::Atomic<bool> prepared = false;
     juce::Atomic<int> size = 0;
     
-    void pushNextSampleIntoFifo(float sample)
+    juce::SpinLock readerLock;
+    
+    void write(const float* src, int numSamples)
     {
-        if (fifoIndex == bufferToFill.getNumSamples())
-        {
-            auto ok = audioBufferFifo.push(bufferToFill);
-
-            juce::ignoreUnused(ok);
-            
-            fifoIndex = 0;
-        }
+        auto position = writePosition.load(std::memory_order_relaxed);
+        auto start = (int)(position & mask);
+        auto firstPart = juce::jmin(numSamples, (int)ring.size() - start);
         
-        bufferToFill.setSample(0, fifoIndex, sample);
-        ++fifoIndex;
+        juce::FloatVectorOperations::copy(ring.data() + start, src, firstPart);
+        juce::FloatVectorOperations::copy(ring.data(), src + firstPart, numSamples - firstPart);
+        
+        writePosition.store(position + (uint64_t)numSamples, std::memory_order_release);
+    }
+    
+    void copyFrom(uint64_t position, float* dest, int numSamples) const
+    {
+        auto start = (int)(position & mask);
+        auto firstPart = juce::jmin(numSamples, (int)ring.size() - start);
+        
+        juce::FloatVectorOperations::copy(dest, ring.data() + start, firstPart);
+        juce::FloatVectorOperations::copy(dest + firstPart, ring.data(), numSamples - firstPart);
     }
 };
 
@@ -169,24 +393,112 @@ enum Slope
     Slope_48
 };
 
+/*
+ While the frequencies, gain or Q are moving, the filters can be redesigned every few samples
+ instead of once per host block. Smaller sub-blocks sound smoother but cost more.
+ */
+enum SmoothingMode
+{
+    Smoothing_Off,
+    Smoothing_16,
+    Smoothing_32,
+    Smoothing_64
+};
+
+//returns the number of samples between redesigns, or 0 if smoothing is off
+inline int getSmoothingSubBlockSize(SmoothingMode mode)
+{
+    return mode == Smoothing_Off ? 0 : 8 << static_cast<int>(mode);
+}
+
+/*
+ How many peak bands the plugin has. Every band gets its own set of parameters,
+ so changing this changes the parameter layout the host sees.
+ */
+#ifndef SIMPLEEQ_NUM_PEAK_BANDS
+ #define SIMPLEEQ_NUM_PEAK_BANDS 8
+#endif
+
+constexpr int NumPeakBands = SIMPLEEQ_NUM_PEAK_BANDS;
+
+static_assert(NumPeakBands >= 1 && NumPeakBands <= 16, "SIMPLEEQ_NUM_PEAK_BANDS must be between 1 and 16");
+
+enum BandType
+{
+    BandType_Peak,
+    BandType_LowShelf,
+    BandType_HighShelf
+};
+
+/*
+ The first band keeps the IDs the plugin has always used ("Peak Freq", "Peak Gain"...),
+ so existing sessions load the same. The others are "Peak 2 Freq", "Peak 3 Freq" and so on.
+ */
+juce::String getPeakParameterID(int band, const juce::String& name);
+
+struct PeakBandSettings
+{
+    float freq { 0 }, gainInDecibels { 0 }, quality { 1.f };
+    BandType type { BandType::BandType_Peak };
+    bool bypassed { false };
+};
+
 struct ChainSettings
 {
-    float peakFreq { 0 }, peakGainInDecibels { 0 }, peakQuality {1.f};
+    std::array<PeakBandSettings, NumPeakBands> peakBands;
     float lowCutFreq { 0 }, highCutFreq { 0 };
     Slope lowCutSlope { Slope::Slope_12 }, highCutSlope { Slope::Slope_12 };
     
     bool lowCutBypassed { false };
-    bool peakBypassed { false };
     bool highCutBypassed { false };
+    
+    SmoothingMode smoothing { SmoothingMode::Smoothing_Off };
+    bool parallelChannels { false };
+    bool linearPhase { false };
+};
+
+/*
+ Looking parameters up by name means a string comparison for every one of them.
+ ChainParameters does those lookups once, so reading the settings is just a handful of atomic loads.
+ */
+struct ChainParameters
+{
+    explicit ChainParameters(juce::AudioProcessorValueTreeState& apvts);
+    
+    struct PeakBand
+    {
+        std::atomic<float>* freq { nullptr };
+        std::atomic<float>* gain { nullptr };
+        std::atomic<float>* quality { nullptr };
+        std::atomic<float>* type { nullptr };
+        std::atomic<float>* bypassed { nullptr };
+    };
+    
+    std::array<PeakBand, NumPeakBands> peakBands;
+    std::atomic<float>* lowCutFreq { nullptr };
+    std::atomic<float>* highCutFreq { nullptr };
+    std::atomic<float>* lowCutSlope { nullptr };
+    std::atomic<float>* highCutSlope { nullptr };
+    std::atomic<float>* lowCutBypassed { nullptr };
+    std::atomic<float>* highCutBypassed { nullptr };
+    std::atomic<float>* smoothing { nullptr };
+    std::atomic<float>* parallelChannels { nullptr };
+    std::atomic<float>* linearPhase { nullptr };
 };
 
 ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
+ChainSettings getChainSettings(const ChainParameters& chainParameters);
+
+using SIMDFloat = juce::dsp::SIMDRegister<float>;
 
-using Filter = juce::dsp::IIR::Filter<float>;
+//the cut filters are up to 4 biquads (48 dB/Oct), run as a single fused cascade
+using SIMDCutFilter = BiquadCascade<SIMDFloat, 4>;
 
-using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
+//every active peak band is one section of this cascade
+using SIMDPeakFilter = BiquadCascade<SIMDFloat, NumPeakBands>;
 
-using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, CutFilter>;
+//one of these processes as many channels as there are lanes in a SIMDFloat
+using SIMDChain = juce::dsp::ProcessorChain<SIMDCutFilter, SIMDPeakFilter, SIMDCutFilter>;
 
 enum ChainPositions
 {
@@ -195,69 +507,358 @@ enum ChainPositions
     HighCut
 };
 
+//bit masks for tracking which positions in the chain need to be redesigned
+enum ChainSections : uint32_t
+{
+    LowCutSection = 1 << ChainPositions::LowCut,
+    PeakSection = 1 << ChainPositions::Peak,
+    HighCutSection = 1 << ChainPositions::HighCut,
+    AllSections = LowCutSection | PeakSection | HighCutSection
+};
 
-using Coefficients = Filter::CoefficientsPtr;
-void updateCoefficients(Coefficients& old, const Coefficients& replacements);
+//returns the sections a parameter affects, or 0 if it doesn't affect the filters at all
+uint32_t getSectionsForParameter(const juce::String& parameterID);
 
-Coefficients makePeakFilter(const ChainSettings& chainSettings, double sampleRate);
+struct CutCoefficients
+{
+    std::array<BiquadCoefficients, 4> sections;
+    Slope slope { Slope::Slope_12 };
+    bool bypassed { false };
+    
+    //each step of the slope adds another 12 dB/Oct biquad
+    int getNumSections() const { return static_cast<int>(slope) + 1; }
+};
 
-template<int Index, typename ChainType, typename CoefficientType>
-void update(ChainType& chain, const CoefficientType& coefficients)
+/*
+ Only the bands that actually do something are kept, packed together at the front of the array.
+ Bypassed bands and bands at 0 dB leave no gap behind, so the cascade just runs fewer sections
+ and never has to check a band's bypass state per sample.
+ */
+struct PeakCoefficients
 {
-    updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
-}
+    std::array<BiquadCoefficients, NumPeakBands> bands;
+    
+    //which band each of the packed sections belongs to
+    std::array<int, NumPeakBands> bandIndices;
+    int numActiveBands = 0;
+};
+
+/*
+ Everything the audio thread needs to configure a SIMDChain.
+ This is designed away from the audio thread and handed over through a TripleBuffer.
+ */
+struct ChainCoefficients
+{
+    CutCoefficients lowCut, highCut;
+    PeakCoefficients peaks;
+    
+    //bumped every time a position is redesigned, so the audio thread only has to copy what actually changed
+    std::array<uint32_t, 3> versions { 0, 0, 0 };
+};
+
+//None of these allocate, so they're safe to call from the audio thread
+CutCoefficients makeLowCutCoefficients(const ChainSettings& chainSettings, double sampleRate);
+CutCoefficients makeHighCutCoefficients(const ChainSettings& chainSettings, double sampleRate);
+BiquadCoefficients makePeakBandCoefficients(const PeakBandSettings& band, double sampleRate);
+PeakCoefficients makePeakCoefficients(const ChainSettings& chainSettings, double sampleRate);
+ChainCoefficients makeChainCoefficients(const ChainSettings& chainSettings, double sampleRate);
+
+//the magnitude of everything in the chain that isn't bypassed
+double getMagnitudeForFrequency(const ChainCoefficients& chainCoefficients, double frequency, double sampleRate);
+
+//the same, at every frequency response was prepared with, all in one go
+void getMagnitudes(const ChainCoefficients& chainCoefficients, MagnitudeResponse& response, double* magnitudes);
+
+/*
+ In linear phase mode the whole chain is replaced by one long FIR with the same magnitude response.
+ Designing that takes a few big FFTs, which is far too much work for the audio thread,
+ so the builder does it on its own thread whenever it's handed new coefficients
+ and publishes the kernel through a TripleBuffer for processBlock to crossfade to.
+ */
+struct LinearPhaseKernelBuilder : juce::Thread
+{
+    LinearPhaseKernelBuilder() : juce::Thread("SimpleEQ linear phase") { }
+    ~LinearPhaseKernelBuilder() override { stopThread(1000); }
+    
+    //allocates, and may only be called while the thread is stopped
+    void prepare(double sampleRate, int kernelLength, int partitionSize);
+    
+    int getNumPartitions() const { return designer.getNumPartitions(); }
+    int getPartitionSize() const { return designer.getPartitionSize(); }
+    int getLatencySamples() const { return designer.getLatencySamples(); }
+    int getKernelLength() const { return designer.getKernelLength(); }
+    
+    //called from the message thread, the newest request wins if several arrive while a kernel is being built
+    void requestKernel(const ChainCoefficients& chainCoefficients);
+    
+    //blocks until every kernel requested so far has been published. Only for offline rendering and prepareToPlay.
+    void waitForPendingKernels();
+    
+    //the reader's side of the TripleBuffer, only for the audio thread. The kernel can be swapped out, see loadKernel().
+    bool acquireKernel() { return kernels.acquire(); }
+    PartitionedKernel& getKernel() { return kernels.getReadBuffer(); }
+    
+    //true once the kernel for the newest request has been published. Safe from any thread.
+    bool isUpToDate() const { return builtGeneration.load() == requestedGeneration.load(); }
+    
+    void run() override;
+private:
+    LinearPhaseKernelDesigner designer;
+    double sampleRate = 0;
+    
+    //the chain's magnitudes at the kernel's bins, prepared along with the designer
+    MagnitudeResponse binResponse;
+    std::vector<double> binMagnitudes;
+    
+    TripleBuffer<PartitionedKernel> kernels;
+    
+    juce::CriticalSection requestLock;
+    ChainCoefficients requestedCoefficients;
+    //only written under requestLock, but isUpToDate() reads it from anywhere
+    std::atomic<uint32_t> requestedGeneration { 0 };
+    std::atomic<uint32_t> builtGeneration { 0 };
+    juce::WaitableEvent kernelBuilt;
+};
 
-template<typename ChainType, typename CoefficientType>
-void updateCutFilter(ChainType& leftLowCut,
-                     const CoefficientType& cutCoefficients,
-                     const Slope& lowCutSlope)
+/*
+ Every channel goes through identical filters, so instead of running a separate set of filters per channel
+ we interleave the channels into the lanes of a SIMD register and run them through one SIMDChain.
+ Each lane keeps its own filter state, and does exactly the same arithmetic IIR::Filter<float> does,
+ so the output matches what a chain of IIR::Filters per channel would produce.
+ 
+ Channels are grouped SIMDFloat::size() at a time, so stereo needs a single chain
+ and wider layouts (5.1, 7.1.4, higher order ambisonics...) just add more groups.
+ The groups don't share anything but the coefficients, so on big layouts
+ they can be spread across a RealtimeWorkerPool.
+ */
+struct MultiChannelChain
 {
+    static constexpr int lanes = (int)SIMDFloat::size();
+    
+    void prepare(const juce::dsp::ProcessSpec& spec)
+    {
+        numChannels = (int)spec.numChannels;
+        auto numGroups = (size_t)juce::jmax(1, (numChannels + lanes - 1) / lanes);
+        
+        chains.clear();
+        chains.resize(numGroups);
+        
+        //each group of channels is a single channel of SIMDFloats in the interleaved block
+        interleaved = juce::dsp::AudioBlock<SIMDFloat>(interleavedData, numGroups, spec.maximumBlockSize);
+        interleaved.clear();
+        
+        auto groupSpec = spec;
+        groupSpec.numChannels = 1;
+        
+        for( auto& chain : chains )
+            chain.prepare(groupSpec);
+    }
     
-    leftLowCut.template setBypassed<0>(true);
-    leftLowCut.template setBypassed<1>(true);
-    leftLowCut.template setBypassed<2>(true);
-    leftLowCut.template setBypassed<3>(true);
+    //if workers is not null, the channel groups are shared out between it and the calling thread
+    void process(const juce::dsp::AudioBlock<float>& block, RealtimeWorkerPool* workers = nullptr)
+    {
+        // Hosts don't always keep to the maximumBlockSize they prepared us with,
+        // so a block that doesn't fit the interleaved block is processed a piece at a time
+        const auto maxChunkSize = interleaved.getNumSamples();
+        if( maxChunkSize == 0 )
+            return;
+        
+        for( size_t start = 0; start < block.getNumSamples(); start += maxChunkSize )
+        {
+            auto chunk = block.getSubBlock(start, juce::jmin(maxChunkSize, block.getNumSamples() - start));
+            processChunk(chunk, workers);
+        }
+    }
     
-    switch( lowCutSlope )
+    void reset()
     {
-        case Slope_48:
+        for( auto& chain : chains )
+            chain.reset();
+    }
+    
+    int getNumGroups() const { return (int)chains.size(); }
+    
+    //lets the caller set up every group's chain in the same way
+    auto begin() { return chains.begin(); }
+    auto end() { return chains.end(); }
+private:
+    int numChannels = 0;
+    std::vector<SIMDChain> chains;
+    
+    juce::HeapBlock<char> interleavedData;
+    juce::dsp::AudioBlock<SIMDFloat> interleaved;
+    
+    //block is never longer than the interleaved block
+    void processChunk(const juce::dsp::AudioBlock<float>& block, RealtimeWorkerPool* workers)
+    {
+        auto channelsToProcess = juce::jmin(numChannels, (int)block.getNumChannels());
+        
+        if( workers != nullptr && workers->getNumWorkers() > 0 && chains.size() > 1 )
         {
-            update<3>(leftLowCut, cutCoefficients);
+            struct Job
+            {
+                MultiChannelChain* chain;
+                const juce::dsp::AudioBlock<float>* block;
+                int channelsToProcess;
+            };
+            
+            Job job { this, &block, channelsToProcess };
+            
+            workers->run(getNumGroups(), [](void* context, int group)
+            {
+                auto* job = static_cast<Job*>(context);
+                job->chain->processGroup((size_t)group, *job->block, job->channelsToProcess);
+            }, &job);
         }
-        case Slope_36:
+        else
         {
-            update<2>(leftLowCut, cutCoefficients);
+            for( size_t group = 0; group < chains.size(); ++group )
+                processGroup(group, block, channelsToProcess);
         }
-        case Slope_24:
+    }
+    
+    //each group only touches its own chain, its own channels and its own part of the interleaved block
+    void processGroup(size_t group, const juce::dsp::AudioBlock<float>& block, int channelsToProcess)
+    {
+        auto numSamples = block.getNumSamples();
+        auto groupBlock = interleaved.getSingleChannelBlock(group).getSubBlock(0, numSamples);
+        auto* lanesData = reinterpret_cast<float*>(groupBlock.getChannelPointer(0));
+        auto firstChannel = (int)group * lanes;
+        
+        for( int lane = 0; lane < lanes; ++lane )
         {
-            update<1>(leftLowCut, cutCoefficients);
+            auto channel = firstChannel + lane;
+            
+            if( channel < channelsToProcess )
+            {
+                auto* src = block.getChannelPointer((size_t)channel);
+                for( size_t i = 0; i < numSamples; ++i )
+                    lanesData[i * lanes + lane] = src[i];
+            }
+            else
+            {
+                for( size_t i = 0; i < numSamples; ++i )
+                    lanesData[i * lanes + lane] = 0.f;
+            }
         }
-        case Slope_12:
+        
+        juce::dsp::ProcessContextReplacing<SIMDFloat> context(groupBlock);
+        chains[group].process(context);
+        
+        for( int lane = 0; lane < lanes; ++lane )
         {
-            update<0>(leftLowCut, cutCoefficients);
+            auto channel = firstChannel + lane;
+            if( channel >= channelsToProcess )
+                break;
+            
+            auto* dst = block.getChannelPointer((size_t)channel);
+            for( size_t i = 0; i < numSamples; ++i )
+                dst[i] = lanesData[i * lanes + lane];
         }
     }
-}
-
-inline auto makeLowCutFilter(const ChainSettings& chainSettings, double sampleRate )
-{
-    return juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chainSettings.lowCutFreq,
-                                                                                       sampleRate,
-                                                                                       2 * (chainSettings.lowCutSlope + 1));
-}
+};
 
-inline auto makeHighCutFilter(const ChainSettings& chainSettings, double sampleRate)
+/*
+ Ramps the continuous parameters towards the values the host gives us.
+ The frequencies ramp multiplicatively, so a sweep moves at a constant rate in octaves.
+ The slopes, band types and bypass switches can't be ramped, those always take the target values.
+ */
+struct ChainSmoothers
 {
-    return juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chainSettings.highCutFreq,
-                                                                                      sampleRate,
-                                                                                      2 * (1 + chainSettings.highCutSlope));
-}
+    void reset(double sampleRate, double rampLengthInSeconds)
+    {
+        lowCutFreq.reset(sampleRate, rampLengthInSeconds);
+        highCutFreq.reset(sampleRate, rampLengthInSeconds);
+        
+        for( auto& band : peakBands )
+        {
+            band.freq.reset(sampleRate, rampLengthInSeconds);
+            band.gain.reset(sampleRate, rampLengthInSeconds);
+            band.quality.reset(sampleRate, rampLengthInSeconds);
+        }
+    }
+    
+    void setCurrentAndTargetValues(const ChainSettings& settings)
+    {
+        lowCutFreq.setCurrentAndTargetValue(settings.lowCutFreq);
+        highCutFreq.setCurrentAndTargetValue(settings.highCutFreq);
+        
+        for( size_t i = 0; i < peakBands.size(); ++i )
+        {
+            peakBands[i].freq.setCurrentAndTargetValue(settings.peakBands[i].freq);
+            peakBands[i].gain.setCurrentAndTargetValue(settings.peakBands[i].gainInDecibels);
+            peakBands[i].quality.setCurrentAndTargetValue(settings.peakBands[i].quality);
+        }
+    }
+    
+    void setTargetValues(const ChainSettings& settings)
+    {
+        lowCutFreq.setTargetValue(settings.lowCutFreq);
+        highCutFreq.setTargetValue(settings.highCutFreq);
+        
+        for( size_t i = 0; i < peakBands.size(); ++i )
+        {
+            peakBands[i].freq.setTargetValue(settings.peakBands[i].freq);
+            peakBands[i].gain.setTargetValue(settings.peakBands[i].gainInDecibels);
+            peakBands[i].quality.setTargetValue(settings.peakBands[i].quality);
+        }
+    }
+    
+    //returns the ChainSections that are still ramping
+    uint32_t getSmoothingSections() const
+    {
+        uint32_t sections = 0;
+        
+        if( lowCutFreq.isSmoothing() )
+            sections |= ChainSections::LowCutSection;
+        
+        for( const auto& band : peakBands )
+        {
+            if( band.freq.isSmoothing() || band.gain.isSmoothing() || band.quality.isSmoothing() )
+            {
+                sections |= ChainSections::PeakSection;
+                break;
+            }
+        }
+        
+        if( highCutFreq.isSmoothing() )
+            sections |= ChainSections::HighCutSection;
+        
+        return sections;
+    }
+    
+    //advances every ramp by numSamples and writes where they ended up into settings
+    void skip(int numSamples, ChainSettings& settings)
+    {
+        settings.lowCutFreq = lowCutFreq.skip(numSamples);
+        settings.highCutFreq = highCutFreq.skip(numSamples);
+        
+        for( size_t i = 0; i < peakBands.size(); ++i )
+        {
+            settings.peakBands[i].freq = peakBands[i].freq.skip(numSamples);
+            settings.peakBands[i].gainInDecibels = peakBands[i].gain.skip(numSamples);
+            settings.peakBands[i].quality = peakBands[i].quality.skip(numSamples);
+        }
+    }
+private:
+    using MultiplicativeSmoother = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative>;
+    
+    struct PeakBandSmoothers
+    {
+        MultiplicativeSmoother freq, quality;
+        juce::SmoothedValue<float> gain;
+    };
+    
+    MultiplicativeSmoother lowCutFreq, highCutFreq;
+    std::array<PeakBandSmoothers, NumPeakBands> peakBands;
+};
 
 //==============================================================================
 /**
 */
-class SimpleEQAudioProcessor  : public juce::AudioProcessor
+class SimpleEQAudioProcessor  : public juce::AudioProcessor,
+                                private juce::AudioProcessorParameter::Listener,
+                                private juce::Timer
 {
 public:
     //==============================================================================
@@ -267,6 +868,8 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+    
+    void audioWorkgroupContextChanged (const juce::AudioWorkgroup& workgroup) override;
 
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
@@ -303,14 +906,122 @@ public:
     using BlockType = juce::AudioBuffer<float>;
     SingleChannelSampleFifo<BlockType> leftChannelFifo { Channel::Left };
     SingleChannelSampleFifo<BlockType> rightChannelFifo { Channel::Right };
+    
+    //how long processBlock has been taking. Safe to call from any thread but the audio thread.
+    ProcessBlockTelemetry::Stats getProcessBlockStats() const { return processBlockTelemetry.getStats(); }
+    void resetProcessBlockStats() { processBlockTelemetry.reset(); }
 private:
     
-    MonoChain leftChain, rightChain;
+    MultiChannelChain filterChain;
+    
+    //only running while Parallel Channels is on and there's more than one group of channels to share out
+    RealtimeWorkerPool channelWorkers;
+    
+    // The workers are started and stopped from prepareToPlay, releaseResources and the timer, which can be on different threads.
+    // The block size, sample rate and number of groups are the ones we were last prepared with,
+    // or 0 once our resources are released.
+    juce::CriticalSection channelWorkersLock;
+    int channelWorkersBlockSize = 0, channelWorkersNumGroups = 0;
+    double channelWorkersSampleRate = 0;
+    
+    //starts or stops the workers to match the Parallel Channels parameter
+    void updateChannelWorkers();
+    
+    RealtimeWorkerPool* getChannelWorkers(const ChainSettings& chainSettings)
+    {
+        return chainSettings.parallelChannels ? &channelWorkers : nullptr;
+    }
+    
+    ChainParameters chainParameters { apvts };
+    
+    // The listener callbacks can arrive on any thread, including the audio thread,
+    // so all they do is mark the affected sections as dirty.
+    // parameterSections maps a parameter index to the sections it affects.
+    std::vector<uint32_t> parameterSections;
+    std::atomic<uint32_t> dirtySections { 0 };
+    
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override { }
+    
+    // The coefficients are designed on the message thread and picked up by processBlock.
+    // designLock only serialises the writers, the audio thread never touches it.
+    // designedCoefficients is the writers' master copy, so a change to one section leaves the others alone.
+    TripleBuffer<ChainCoefficients> coefficientBuffer;
+    juce::CriticalSection designLock;
+    ChainCoefficients designedCoefficients;
+    
+    //the versions of the coefficients currently loaded into the cascades. Only used on the audio thread.
+    std::array<uint32_t, 3> appliedVersions { 0, 0, 0 };
+    
+    void timerCallback() override;
+    
+    void updatePeakFilters(const PeakCoefficients& peaks);
+    
+    //the section each band is loaded into, or -1 if it isn't active. Only used on the audio thread.
+    std::array<int, NumPeakBands> appliedPeakSlots;
+    void updateLowCutFilters(const CutCoefficients& lowCut);
+    void updateHighCutFilters(const CutCoefficients& highCut);
+    
+    //copies the sections that changed since the last call, plus any in sectionsToForce, into the cascades
+    void applyCoefficients(const ChainCoefficients& chainCoefficients, uint32_t sectionsToForce = 0);
+    
+    // When smoothing is on, the audio thread ramps the continuous parameters itself
+    // and redesigns the moving sections every sub-block.
+    // smoothingActive is true while the cascades may hold coefficients we designed here rather than the published ones.
+    ChainSmoothers smoothers;
+    bool smoothingActive = false;
+    static constexpr double smoothingRampLengthInSeconds = 0.05;
+    
+    //settings holds the current parameter values, which become the targets of the ramps
+    void processWithSmoothing(const juce::dsp::AudioBlock<float>& block, ChainSettings settings, int subBlockSize);
+    
+    //redesigns the given sections from the current parameters and publishes the result to the audio thread
+    void updateFilters(uint32_t sections = ChainSections::AllSections);
+    
+    //runs the block through the filters, with or without smoothing
+    void processMinimumPhase(const juce::dsp::AudioBlock<float>& block, const ChainSettings& settings, int subBlockSize);
+    
+    /*
+     Linear phase mode. Kernels are only built while the mode is on, kernelFollowsCoefficients is only written under designLock.
+     Switching the mode on requests a kernel for the current coefficients, and the filters carry on until it's loaded.
+     
+     Neither path is simply swapped for the other. Switching on, the convolver is fed alongside the filters
+     until it has a whole kernel's worth of input. Then the filters fade out over linearPhaseSwitchSeconds
+     and the convolver fades in over the same time, switching off goes back the same way.
+     The two paths have different latencies, so crossfading them would comb filter while they overlap,
+     fading through silence doesn't. The latency reported to the host changes at that silent sample, from the audio thread.
+     */
+    LinearPhaseKernelBuilder kernelBuilder;
+    UniformPartitionedConvolver linearPhaseConvolver;
+    std::atomic<bool> kernelFollowsCoefficients { false };
+    
+    //requests a kernel if the mode has just been switched on. Not for the audio thread, except while rendering offline.
+    void updateKernelRequests();
+    
+    // Only used on the audio thread.
+    // linearPhaseActive is the mode we're in or switching to, linearPhaseRunning is true while the convolver is being fed,
+    // linearPhaseHeard is the path in the output, which linearPhaseSwitchGain fades in or out.
+    bool linearPhaseActive = false, linearPhaseRunning = false, linearPhaseKernelLoaded = false, linearPhaseHeard = false;
+    int linearPhaseWarmup = 0;
+    juce::LinearSmoothedValue<float> linearPhaseSwitchGain;
+    juce::AudioBuffer<float> linearPhaseInput;
+    
+    static constexpr int linearPhasePartitionSize = 256;
+    static constexpr double linearPhaseSwitchSeconds = 0.01;
+    
+    //the convolver's output alone, with no switch going on either way
+    bool isOnlyLinearPhaseRunning() const
+    {
+        return linearPhaseRunning && linearPhaseWarmup == 0 && linearPhaseActive && linearPhaseHeard && ! linearPhaseSwitchGain.isSmoothing();
+    }
+    
+    void updateLinearPhaseSwitch(bool linearPhase, bool kernelIsUpToDate);
+    void processLinearPhaseSwitch(const juce::dsp::AudioBlock<float>& block, const ChainSettings& settings, int subBlockSize);
+    
+    //the latency to report for the given mode
+    int getLatencyForMode(bool linearPhase) const;
     
-    void updatePeakFilter(const ChainSettings& chainSettings);
-    void updateLowCutFilters(const ChainSettings& chainSettings);
-    void updateHighCutFilters(const ChainSettings& chainSettings);
-    void updateFilters();
+    ProcessBlockTelemetry processBlockTelemetry;
     
     juce::dsp::Oscillator<float> osc;
     
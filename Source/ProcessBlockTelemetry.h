@@ -0,0 +1,176 @@
+/*
+  ==============================================================================
+
+    ProcessBlockTelemetry.h
+
+    Records how long each processBlock call took, so we can tell whether we're the ones causing dropouts.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+ The audio thread writes one entry per block into a ring of atomics, which costs two clock reads and a store.
+ Anybody else can read the ring at any time to work out the statistics. Nothing waits on anything.
+
+ The load of a block is how long processing it took, divided by how long it lasts when it's played.
+ A load of 1 or more means we took the whole time budget for that block by ourselves,
+ and the host would have dropped out even if nothing else was running.
+ */
+class ProcessBlockTelemetry
+{
+public:
+    struct Stats
+    {
+        //blocks recorded since the last reset, and how many of them had a load of 1 or more
+        int numBlocks = 0, numOverruns = 0;
+
+        //over the most recent blocks, at most getCapacity() of them
+        float p50Load = 0, p99Load = 0;
+
+        //since the last reset
+        float maxLoad = 0;
+
+        double p50Microseconds = 0, p99Microseconds = 0;
+        int lastBlockSize = 0;
+    };
+
+    //measures from construction to destruction, so every way out of processBlock is covered
+    struct ScopedTimer
+    {
+        ScopedTimer(ProcessBlockTelemetry& t, int numSamplesToProcess) :
+        telemetry(t),
+        numSamples(numSamplesToProcess),
+        start(juce::Time::getHighResolutionTicks())
+        {
+        }
+
+        ~ScopedTimer()
+        {
+            telemetry.record(juce::Time::getHighResolutionTicks() - start, numSamples);
+        }
+    private:
+        ProcessBlockTelemetry& telemetry;
+        int numSamples;
+        juce::int64 start;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedTimer)
+    };
+
+    //the load of a block depends on the sample rate, so call this before processing starts
+    void prepare(double newSampleRate)
+    {
+        sampleRate.store(newSampleRate);
+        reset();
+    }
+
+    //can be called from any thread
+    void reset()
+    {
+        firstEntry.store(numEntries.load());
+        maxLoad.store(0.f);
+        numOverruns.store(0);
+    }
+
+    //only for the audio thread
+    void record(juce::int64 ticks, int numSamples)
+    {
+        if( numSamples <= 0 )
+            return;
+
+        const auto clampedTicks = (uint64_t)juce::jlimit((juce::int64)0, (juce::int64)UINT32_MAX, ticks);
+        const auto load = getLoad(clampedTicks, numSamples);
+
+        if( load >= 1.f )
+            numOverruns.fetch_add(1, std::memory_order_relaxed);
+
+        // A reset can come in from another thread at any point, so the max has to be raised with a CAS
+        auto previousMax = maxLoad.load(std::memory_order_relaxed);
+        while( load > previousMax && ! maxLoad.compare_exchange_weak(previousMax, load, std::memory_order_relaxed) ) { }
+
+        auto index = numEntries.load(std::memory_order_relaxed);
+        entries[index % capacity].store((clampedTicks << 32) | (uint32_t)numSamples, std::memory_order_relaxed);
+        numEntries.store(index + 1, std::memory_order_release);
+    }
+
+    /*
+     Safe from any thread but the audio thread, and doesn't allocate.
+     Entries can be overwritten while we're reading them, which only ever swaps one recent block for an even newer one.
+     */
+    Stats getStats() const
+    {
+        Stats stats;
+
+        const auto end = numEntries.load(std::memory_order_acquire);
+        const auto numSinceReset = end - firstEntry.load();
+        const auto count = (int)std::min<uint32_t>(numSinceReset, (uint32_t)capacity);
+
+        stats.numBlocks = (int)numSinceReset;
+        stats.numOverruns = numOverruns.load();
+        stats.maxLoad = maxLoad.load();
+
+        if( count == 0 )
+            return stats;
+
+        std::array<float, capacity> loads;
+        std::array<double, capacity> microseconds;
+        const auto microsecondsPerTick = 1.0e6 / (double)juce::Time::getHighResolutionTicksPerSecond();
+
+        for( int i = 0; i < count; ++i )
+        {
+            auto entry = entries[(end - (uint32_t)count + (uint32_t)i) % capacity].load(std::memory_order_relaxed);
+            auto ticks = entry >> 32;
+            auto numSamples = (int)(entry & 0xffffffff);
+
+            loads[(size_t)i] = getLoad(ticks, numSamples);
+            microseconds[(size_t)i] = (double)ticks * microsecondsPerTick;
+
+            if( i == count - 1 )
+                stats.lastBlockSize = numSamples;
+        }
+
+        stats.p50Load = getPercentile(loads.data(), count, 0.5);
+        stats.p99Load = getPercentile(loads.data(), count, 0.99);
+        stats.p50Microseconds = getPercentile(microseconds.data(), count, 0.5);
+        stats.p99Microseconds = getPercentile(microseconds.data(), count, 0.99);
+
+        return stats;
+    }
+
+    static constexpr int getCapacity() { return capacity; }
+private:
+    static constexpr int capacity = 1024;
+
+    //the block's duration in ticks in the top 32 bits, its length in samples in the bottom 32
+    std::array<std::atomic<uint64_t>, capacity> entries {};
+
+    //counts every entry ever written, wrapping around is fine since we only ever look at differences
+    std::atomic<uint32_t> numEntries { 0 }, firstEntry { 0 };
+
+    std::atomic<float> maxLoad { 0.f };
+    std::atomic<int> numOverruns { 0 };
+    std::atomic<double> sampleRate { 44100 };
+
+    float getLoad(uint64_t ticks, int numSamples) const
+    {
+        auto seconds = juce::Time::highResolutionTicksToSeconds((juce::int64)ticks);
+        return (float)(seconds * sampleRate.load(std::memory_order_relaxed) / numSamples);
+    }
+
+    //partially sorts values, which is fine for the copies getStats works on
+    template<typename T>
+    static T getPercentile(T* values, int count, double percentile)
+    {
+        auto nth = values + juce::jlimit(0, count - 1, (int)(percentile * count));
+        std::nth_element(values, nth, values + count);
+        return *nth;
+    }
+};
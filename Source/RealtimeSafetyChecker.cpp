@@ -0,0 +1,455 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyChecker.cpp
+
+  ==============================================================================
+*/
+
+#include "RealtimeSafetyChecker.h"
+
+#if SIMPLEEQ_RT_CHECKS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <execinfo.h>
+#endif
+
+#if JUCE_LINUX && defined(__GLIBC__)
+ #include <cerrno>
+ #include <dlfcn.h>
+ #include <pthread.h>
+ #include <sched.h>
+ #define SIMPLEEQ_RT_CHECKS_HOOK_LIBC 1
+#else
+ #define SIMPLEEQ_RT_CHECKS_HOOK_LIBC 0
+#endif
+
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+namespace
+{
+    constexpr int maxFrames = 32;
+    constexpr int maxSites = 64;
+
+    struct ViolationSite
+    {
+        RealtimeSafetyChecker::ViolationType type;
+        void* frames[maxFrames];
+        int numFrames;
+        int count;
+    };
+
+    // Nothing in here may allocate or take a mutex, we'd only end up back in the hooks.
+    // So the sites live in static storage, behind a spin lock.
+    ViolationSite sites[maxSites];
+    int numSites = 0;
+    std::atomic_flag sitesLock = ATOMIC_FLAG_INIT;
+    std::atomic<int> numViolations { 0 };
+
+    thread_local int realtimeDepth = 0;
+
+    //set while a violation is being recorded, so whatever that does itself isn't reported
+    thread_local bool reporting = false;
+
+    struct ScopedSitesLock
+    {
+        ScopedSitesLock() { while( sitesLock.test_and_set(std::memory_order_acquire) ) { } }
+        ~ScopedSitesLock() { sitesLock.clear(std::memory_order_release); }
+    };
+
+    const char* getName(RealtimeSafetyChecker::ViolationType type)
+    {
+        switch( type )
+        {
+            case RealtimeSafetyChecker::Allocation: return "allocation";
+            case RealtimeSafetyChecker::Deallocation: return "deallocation";
+            case RealtimeSafetyChecker::Lock: return "mutex lock";
+        }
+
+        return "";
+    }
+
+   #if SIMPLEEQ_RT_CHECKS_HOOK_LIBC
+    using MutexLockFunction = int (*)(pthread_mutex_t*);
+
+    /*
+     Static initializers in other files can lock a mutex before anything in this one has been initialized,
+     so the real pthread_mutex_lock is looked up the first time it's needed rather than by a global's initializer.
+     The atomic is constant initialized, so it's there from the very start.
+     Returns nullptr while the lookup is still running on this thread, or if it failed.
+     */
+    MutexLockFunction getRealMutexLock()
+    {
+        static std::atomic<MutexLockFunction> realMutexLock { nullptr };
+        static thread_local bool resolving = false;
+
+        auto function = realMutexLock.load(std::memory_order_acquire);
+
+        if( function == nullptr && ! resolving )
+        {
+            resolving = true;
+            function = reinterpret_cast<MutexLockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+            resolving = false;
+
+            if( function != nullptr )
+                realMutexLock.store(function, std::memory_order_release);
+        }
+
+        return function;
+    }
+
+    //trylock isn't hooked, so spinning on it locks the mutex without needing the real pthread_mutex_lock
+    int lockBySpinning(pthread_mutex_t* mutex)
+    {
+        for( ;; )
+        {
+            auto result = pthread_mutex_trylock(mutex);
+            if( result != EBUSY )
+                return result;
+
+            sched_yield();
+        }
+    }
+
+    //normally the lookup has happened by the time main() runs, so the hook never has to do it on the audio thread
+    [[maybe_unused]] const bool mutexLockResolved = getRealMutexLock() != nullptr;
+   #endif
+}
+
+extern "C"
+{
+   #if SIMPLEEQ_RT_CHECKS_HOOK_LIBC
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+   #endif
+}
+
+static void* allocate(size_t size)
+{
+   #if SIMPLEEQ_RT_CHECKS_HOOK_LIBC
+    return __libc_malloc(size);
+   #else
+    return std::malloc(size);
+   #endif
+}
+
+static void deallocate(void* p)
+{
+   #if SIMPLEEQ_RT_CHECKS_HOOK_LIBC
+    __libc_free(p);
+   #else
+    std::free(p);
+   #endif
+}
+
+//alignment is always a power of two, since it comes from a std::align_val_t
+static void* allocateAligned(size_t size, size_t alignment)
+{
+    alignment = std::max(alignment, sizeof(void*));
+
+   #if SIMPLEEQ_RT_CHECKS_HOOK_LIBC
+    return __libc_memalign(alignment, size);
+   #elif JUCE_WINDOWS
+    return _aligned_malloc(size, alignment);
+   #else
+    void* p = nullptr;
+    return posix_memalign(&p, alignment, size) == 0 ? p : nullptr;
+   #endif
+}
+
+static void deallocateAligned(void* p)
+{
+   #if JUCE_WINDOWS
+    _aligned_free(p);
+   #else
+    deallocate(p);
+   #endif
+}
+
+RealtimeSafetyChecker::ScopedRealtimeThread::ScopedRealtimeThread(bool isRealtime) : active(isRealtime)
+{
+    if( active )
+        ++realtimeDepth;
+}
+
+RealtimeSafetyChecker::ScopedRealtimeThread::~ScopedRealtimeThread()
+{
+    if( active )
+        --realtimeDepth;
+}
+
+void RealtimeSafetyChecker::reportViolation(ViolationType type)
+{
+    if( realtimeDepth == 0 || reporting )
+        return;
+
+    reporting = true;
+    ++numViolations;
+
+    void* frames[maxFrames];
+   #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+    auto numFrames = backtrace(frames, maxFrames);
+   #else
+    int numFrames = 0;
+   #endif
+
+    {
+        ScopedSitesLock lock;
+
+        auto* site = std::find_if(sites, sites + numSites, [&](const ViolationSite& s)
+        {
+            return s.type == type
+                && s.numFrames == numFrames
+                && std::memcmp(s.frames, frames, sizeof(void*) * (size_t)numFrames) == 0;
+        });
+
+        if( site != sites + numSites )
+        {
+            ++site->count;
+        }
+        else if( numSites < maxSites )
+        {
+            site = &sites[numSites++];
+            site->type = type;
+            site->numFrames = numFrames;
+            site->count = 1;
+            std::memcpy(site->frames, frames, sizeof(void*) * (size_t)numFrames);
+        }
+    }
+
+    reporting = false;
+}
+
+int RealtimeSafetyChecker::getNumViolations()
+{
+    return numViolations.load();
+}
+
+juce::String RealtimeSafetyChecker::getReport()
+{
+    //copied out first, symbolising allocates and would land us back in reportViolation's lock
+    ViolationSite copies[maxSites];
+    int numCopies = 0;
+
+    {
+        ScopedSitesLock lock;
+        numCopies = numSites;
+        std::copy(sites, sites + numSites, copies);
+    }
+
+    juce::String report;
+    report << numViolations.load() << " real-time safety violation(s) at " << numCopies << " place(s)" << juce::newLine;
+
+    for( int i = 0; i < numCopies; ++i )
+    {
+        auto& site = copies[i];
+        report << juce::newLine << site.count << "x " << getName(site.type) << juce::newLine;
+
+       #if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+        if( auto* symbols = backtrace_symbols(site.frames, site.numFrames) )
+        {
+            //the first frame is always reportViolation itself
+            for( int frame = 1; frame < site.numFrames; ++frame )
+                report << "    " << symbols[frame] << juce::newLine;
+
+            std::free(symbols);
+        }
+       #else
+        report << "    (no stack traces on this platform)" << juce::newLine;
+       #endif
+    }
+
+    return report;
+}
+
+void RealtimeSafetyChecker::reset()
+{
+    ScopedSitesLock lock;
+    numSites = 0;
+    numViolations = 0;
+}
+
+//==============================================================================
+void* operator new(std::size_t size)
+{
+    RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+
+    if( auto* p = allocate(size == 0 ? 1 : size) )
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+    return allocate(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    if( p != nullptr )
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Deallocation);
+
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    operator delete(p);
+}
+
+// The aligned forms are what SIMD types like the filters' SIMDRegisters get allocated with
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+
+    if( auto* p = allocateAligned(size == 0 ? 1 : size, static_cast<std::size_t>(alignment)) )
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+    return allocateAligned(size == 0 ? 1 : size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    if( p != nullptr )
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Deallocation);
+
+    deallocateAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(p, alignment);
+}
+
+#if SIMPLEEQ_RT_CHECKS_HOOK_LIBC
+// Defining these in the executable puts them in front of glibc's for the whole process,
+// which catches JUCE's CriticalSections and anything that calls malloc directly.
+extern "C"
+{
+    void* malloc(size_t size)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+        return __libc_realloc(p, size);
+    }
+
+    void free(void* p)
+    {
+        if( p != nullptr )
+            RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Deallocation);
+
+        __libc_free(p);
+    }
+
+    // The aligned allocators don't go through malloc, so they need hooking too
+    void* memalign(size_t alignment, size_t size)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Allocation);
+
+        //the same checks glibc makes
+        if( alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0 )
+            return EINVAL;
+
+        auto* p = __libc_memalign(alignment, size);
+        if( p == nullptr )
+            return ENOMEM;
+
+        *result = p;
+        return 0;
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex)
+    {
+        RealtimeSafetyChecker::reportViolation(RealtimeSafetyChecker::Lock);
+
+        if( auto realMutexLock = getRealMutexLock() )
+            return realMutexLock(mutex);
+
+        return lockBySpinning(mutex);
+    }
+}
+#endif
+
+#endif
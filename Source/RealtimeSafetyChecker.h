@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    RealtimeSafetyChecker.h
+
+    Catches allocations and locks on the audio thread in test builds.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+ Build with SIMPLEEQ_RT_CHECKS=1 to turn the checker on. Everything here compiles away otherwise.
+
+ The checker replaces operator new and delete, and on Linux malloc, free and pthread_mutex_lock too.
+ Every call to one of those from a thread that is inside a ScopedRealtimeThread counts as a violation.
+ Violations are grouped by their call stack, so the report shows each offending place once
+ along with how many times it was hit.
+ */
+#ifndef SIMPLEEQ_RT_CHECKS
+ #define SIMPLEEQ_RT_CHECKS 0
+#endif
+
+#if SIMPLEEQ_RT_CHECKS
+
+struct RealtimeSafetyChecker
+{
+    enum ViolationType
+    {
+        Allocation,
+        Deallocation,
+        Lock
+    };
+
+    //marks the calling thread as real-time until this goes out of scope. Scopes can be nested.
+    struct ScopedRealtimeThread
+    {
+        explicit ScopedRealtimeThread(bool isRealtime = true);
+        ~ScopedRealtimeThread();
+    private:
+        bool active;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedRealtimeThread)
+    };
+
+    //called by the hooks, does nothing unless the calling thread is real-time
+    static void reportViolation(ViolationType type);
+
+    static int getNumViolations();
+
+    //the violations so far, each with its call stack and how often it happened
+    static juce::String getReport();
+
+    static void reset();
+};
+
+#endif
@@ -0,0 +1,276 @@
+/*
+  ==============================================================================
+
+    RealtimeWorkerPool.h
+
+    A few helper threads the audio thread can hand independent jobs to.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#include "RealtimeSafetyChecker.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+/*
+ The audio thread must never block waiting for another thread to wake up.
+
+ So the audio thread doesn't hand jobs out, it just announces a batch and then claims jobs from
+ the same counter the workers use. If no worker is awake it ends up doing every job itself,
+ which is no slower than not having a pool at all.
+ The only time it waits is for jobs that a worker has already claimed and is busy running.
+ So that wait can't turn into a priority inversion, the workers are real-time threads like the audio thread,
+ and they join the host's audio workgroup when it gives us one.
+
+ There are no locks or events on the audio thread, the workers notice a new batch by polling.
+ Batches come once per block, so each worker learns how far apart they are, sleeps through most of the gap,
+ and only spins for spinMarginMs either side of when the next one is due.
+ Once things have been quiet for longer than that, they poll once a millisecond so an idle pool costs next to nothing.
+ */
+class RealtimeWorkerPool
+{
+public:
+    using JobFunction = void (*)(void* context, int jobIndex);
+
+    ~RealtimeWorkerPool()
+    {
+        stop();
+    }
+
+    /*
+     Not for the audio thread, but safe while it's calling run(): it just does whatever jobs the workers don't.
+     The block size and sample rate tell the OS how much time the workers need per block.
+     */
+    void start(int numWorkers, int blockSize, double sampleRate)
+    {
+        stop();
+
+        const auto options = juce::Thread::RealtimeOptions{}.withApproximateAudioProcessingTime(juce::jmax(1, blockSize), sampleRate);
+
+        for( int i = 0; i < numWorkers; ++i )
+        {
+            workers.push_back(std::make_unique<Worker>(*this));
+
+            if( ! workers.back()->startRealtimeThread(options) )
+                workers.back()->startThread(juce::Thread::Priority::highest);
+        }
+
+        numRunningWorkers.store(numWorkers);
+    }
+
+    void stop()
+    {
+        numRunningWorkers.store(0);
+
+        for( auto& worker : workers )
+            worker->signalThreadShouldExit();
+
+        for( auto& worker : workers )
+            worker->stopThread(1000);
+
+        workers.clear();
+    }
+
+    //safe from any thread
+    int getNumWorkers() const { return numRunningWorkers.load(); }
+
+    //not for the audio thread. The workers join the new workgroup, and leave the old one, the next time they poll.
+    void setWorkgroup(const juce::AudioWorkgroup& newWorkgroup)
+    {
+        {
+            const juce::SpinLock::ScopedLockType lock(workgroupLock);
+            workgroup = newWorkgroup;
+        }
+
+        ++workgroupGeneration;
+    }
+
+    /*
+     Runs function(context, i) for every i in [0, numJobs) and returns once they have all finished.
+     Only one thread may call this at a time, normally the audio thread.
+     */
+    void run(int numJobs, JobFunction function, void* context)
+    {
+        if( numJobs <= 0 )
+            return;
+
+        jassert(numJobs <= maxJobs);
+        numJobs = juce::jmin(numJobs, maxJobs);
+
+        jobFunction.store(function, std::memory_order_relaxed);
+        jobContext.store(context, std::memory_order_relaxed);
+        jobsFinished.store(0, std::memory_order_relaxed);
+
+        // The generation, the number of jobs and the next job index all live in the one atomic,
+        // so a worker that wakes up late can never claim a job from a batch that has already moved on.
+        const auto generation = ++lastGeneration;
+        state.store(makeState(generation, numJobs, 0), std::memory_order_release);
+
+        runJobs(generation);
+
+        while( jobsFinished.load(std::memory_order_acquire) < numJobs )
+            pause();
+    }
+private:
+    struct Worker : juce::Thread
+    {
+        explicit Worker(RealtimeWorkerPool& p) : juce::Thread("SimpleEQ worker"), pool(p) { }
+
+        void run() override
+        {
+            uint32_t lastSeenGeneration = getGeneration(pool.state.load(std::memory_order_acquire));
+            auto lastBatchMs = juce::Time::getMillisecondCounterHiRes();
+
+            //how far apart the batches have been coming, or 0 until we've seen two in a row
+            double batchPeriodMs = 0;
+
+            while( ! threadShouldExit() )
+            {
+                updateWorkgroup();
+
+                auto generation = getGeneration(pool.state.load(std::memory_order_acquire));
+                auto now = juce::Time::getMillisecondCounterHiRes();
+                auto sinceLastBatch = now - lastBatchMs;
+
+                if( generation != lastSeenGeneration )
+                {
+                    lastSeenGeneration = generation;
+                    pool.runJobs(generation);
+
+                    //a gap longer than the idle timeout is a pause in playback, not the block rate
+                    if( sinceLastBatch < idleTimeoutMs )
+                        batchPeriodMs = batchPeriodMs > 0 ? batchPeriodMs + (sinceLastBatch - batchPeriodMs) * 0.125 : sinceLastBatch;
+
+                    lastBatchMs = now;
+                }
+                else if( sinceLastBatch < batchPeriodMs - spinMarginMs )
+                {
+                    auto sleepMs = batchPeriodMs - spinMarginMs - sinceLastBatch;
+                    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(sleepMs));
+                }
+                else if( sinceLastBatch < batchPeriodMs + spinMarginMs )
+                {
+                    pause();
+                }
+                else
+                {
+                    //the batch we expected didn't come, so stop expecting them until they start again
+                    if( sinceLastBatch >= idleTimeoutMs )
+                        batchPeriodMs = 0;
+
+                    wait(1);
+                }
+            }
+        }
+
+        RealtimeWorkerPool& pool;
+        juce::WorkgroupToken workgroupToken;
+        int joinedWorkgroupGeneration = 0;
+
+        void updateWorkgroup()
+        {
+            auto generation = pool.workgroupGeneration.load();
+            if( generation == joinedWorkgroupGeneration )
+                return;
+
+            joinedWorkgroupGeneration = generation;
+            workgroupToken.reset();
+
+            juce::AudioWorkgroup newWorkgroup;
+
+            {
+                const juce::SpinLock::ScopedLockType lock(pool.workgroupLock);
+                newWorkgroup = pool.workgroup;
+            }
+
+            //an empty workgroup, or one on a platform without them, leaves the token empty
+            if( newWorkgroup )
+                newWorkgroup.join(workgroupToken);
+        }
+    };
+
+    //how long before and after the next batch is due the workers spin for it
+    static constexpr double spinMarginMs = 0.25;
+
+    //a gap between batches longer than this means playback has stopped
+    static constexpr double idleTimeoutMs = 50;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> numRunningWorkers { 0 };
+
+    juce::SpinLock workgroupLock;
+    juce::AudioWorkgroup workgroup;
+    std::atomic<int> workgroupGeneration { 0 };
+
+    // generation in the top 32 bits, then the number of jobs, then the next job to claim
+    std::atomic<uint64_t> state { 0 };
+    std::atomic<int> jobsFinished { 0 };
+    uint32_t lastGeneration = 0;
+
+    // These only change between batches, while nobody can claim a job.
+    // Claiming a job acquires the state that was released after they were written.
+    std::atomic<JobFunction> jobFunction { nullptr };
+    std::atomic<void*> jobContext { nullptr };
+
+    static constexpr int maxJobs = 0xffff;
+
+    static uint64_t makeState(uint32_t generation, int numJobs, int nextJob)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(numJobs) << 16) | static_cast<uint64_t>(nextJob);
+    }
+
+    static uint32_t getGeneration(uint64_t s) { return static_cast<uint32_t>(s >> 32); }
+    static int getNumJobs(uint64_t s) { return static_cast<int>((s >> 16) & 0xffff); }
+    static int getNextJob(uint64_t s) { return static_cast<int>(s & 0xffff); }
+
+    static void pause()
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #else
+        std::this_thread::yield();
+       #endif
+    }
+
+    void runJobs(uint32_t generation)
+    {
+        auto current = state.load(std::memory_order_acquire);
+
+        for( ;; )
+        {
+            if( getGeneration(current) != generation )
+                return;
+
+            auto jobIndex = getNextJob(current);
+
+            if( jobIndex >= getNumJobs(current) )
+                return;
+
+            if( state.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire) )
+            {
+               #if SIMPLEEQ_RT_CHECKS
+                //a job is part of processBlock whichever thread ends up running it
+                RealtimeSafetyChecker::ScopedRealtimeThread realtimeScope;
+               #endif
+
+                jobFunction.load(std::memory_order_relaxed)(jobContext.load(std::memory_order_relaxed), jobIndex);
+                jobsFinished.fetch_add(1, std::memory_order_release);
+                current = state.load(std::memory_order_acquire);
+            }
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE(RealtimeWorkerPool)
+};
@@ -0,0 +1,851 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Measures how long SimpleEQAudioProcessor::processBlock takes per sample.
+
+    Every combination of block size, sample rate, cut filter slopes and bypass switches is timed
+    and written out as JSON or CSV. Given the results of an earlier run as a baseline,
+    each configuration also gets its change from the baseline, and regressions are counted.
+
+    SimpleEQBenchmark [options]
+
+      --block-sizes <list>    comma separated (default: 16,32,64,128,256,512,1024,2048,4096)
+      --sample-rates <list>   comma separated (default: 44100,48000,88200,96000,176400,192000)
+      --slopes <list>         dB/Oct values used for both cut filters (default: 12,24,36,48)
+      --bypass <all|none>     whether to time every bypass permutation (default: all)
+      --smoothing <all|off>   whether to time every smoothing mode as well (default: off)
+      --linear-phase          time linear phase mode as well
+      --peak-bands <n>        how many peak bands are active (default: 1)
+      --channels <n>          (default: 2)
+      --repetitions <n>       timed runs per configuration, the median is reported (default: 5)
+      --seconds <s>           length of audio processed per run (default: 0.1)
+      --format <json|csv>     (default: json)
+      --output <file>         (default: stdout)
+      --baseline <file>       the JSON output of an earlier run to compare against
+      --threshold <percent>   how much slower than the baseline counts as a regression (default: 5)
+      --fail-on-regression    exit with 1 if anything regressed
+      --rt-check              exit with 1 if processBlock allocated or locked anything, with a report of where.
+                              Needs a build with SIMPLEEQ_RT_CHECKS=1, like the RealtimeChecks configuration,
+                              whose timings are only good for comparing with each other.
+      --analyzer              times the analyzer's conversion of spectra to decibels at each FFT order instead,
+                              the scalar loops it used to run against FastDecibels, along with the largest difference
+      --response              times MagnitudeResponse against getMagnitudeForFrequency at each sample rate instead,
+                              with every filter in the chain active, and checks it stays within its stated tolerance
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/RealtimeSafetyChecker.h"
+#include "../../../Source/FastDecibels.h"
+
+#include <algorithm>
+#include <complex>
+#include <iostream>
+#include <map>
+#include <vector>
+
+struct BenchmarkConfig
+{
+    double sampleRate = 48000;
+    int blockSize = 512;
+    Slope lowCutSlope = Slope_12, highCutSlope = Slope_12;
+    bool lowCutBypassed = false, peakBypassed = false, highCutBypassed = false;
+    SmoothingMode smoothing = Smoothing_Off;
+    bool linearPhase = false;
+
+    //identifies the configuration when comparing against a baseline
+    juce::String getName() const
+    {
+        juce::String name;
+        name << "sr=" << juce::roundToInt(sampleRate)
+             << " block=" << blockSize
+             << " low=" << getSlopeInDecibels(lowCutSlope)
+             << " high=" << getSlopeInDecibels(highCutSlope)
+             << " bypass=" << (lowCutBypassed ? "L" : "-") << (peakBypassed ? "P" : "-") << (highCutBypassed ? "H" : "-")
+             << " smoothing=" << getSmoothingSubBlockSize(smoothing)
+             << (linearPhase ? " linear" : "");
+        return name;
+    }
+
+    static int getSlopeInDecibels(Slope slope) { return 12 * (static_cast<int>(slope) + 1); }
+};
+
+struct BenchmarkResult
+{
+    BenchmarkConfig config;
+    double medianNsPerSample = 0, minNsPerSample = 0;
+
+    //only set when there's a baseline with the same configuration in it
+    bool hasBaseline = false;
+    double baselineNsPerSample = 0, deltaPercent = 0;
+};
+
+struct BenchmarkOptions
+{
+    juce::Array<int> blockSizes { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    juce::Array<double> sampleRates { 44100, 48000, 88200, 96000, 176400, 192000 };
+    juce::Array<Slope> slopes { Slope_12, Slope_24, Slope_36, Slope_48 };
+    bool allBypassPermutations = true;
+    bool allSmoothingModes = false;
+    bool linearPhase = false;
+    int numPeakBands = 1;
+    int numChannels = 2;
+    int repetitions = 5;
+    double secondsPerRun = 0.1;
+    bool csv = false;
+    juce::File output, baseline;
+    double regressionThresholdPercent = 5;
+    bool failOnRegression = false;
+    bool realtimeCheck = false;
+    bool analyzer = false;
+    bool response = false;
+};
+
+static void setParameter(SimpleEQAudioProcessor& processor, const juce::String& id, float value)
+{
+    auto* param = processor.apvts.getParameter(id);
+    jassert(param != nullptr);
+
+    param->setValueNotifyingHost(param->convertTo0to1(value));
+}
+
+static void configure(SimpleEQAudioProcessor& processor, const BenchmarkConfig& config, const BenchmarkOptions& options)
+{
+    setParameter(processor, "LowCut Freq", 80.f);
+    setParameter(processor, "HighCut Freq", 12000.f);
+    setParameter(processor, "LowCut Slope", (float)config.lowCutSlope);
+    setParameter(processor, "HighCut Slope", (float)config.highCutSlope);
+    setParameter(processor, "LowCut Bypassed", config.lowCutBypassed ? 1.f : 0.f);
+    setParameter(processor, "HighCut Bypassed", config.highCutBypassed ? 1.f : 0.f);
+    setParameter(processor, "Smoothing", (float)config.smoothing);
+    setParameter(processor, "Linear Phase", config.linearPhase ? 1.f : 0.f);
+
+    // A band at 0 dB never reaches the audio thread, so the active ones need some gain.
+    // The peak bypass switch is the first band's, like in the editor.
+    for( int band = 0; band < NumPeakBands; ++band )
+    {
+        setParameter(processor, getPeakParameterID(band, "Gain"), band < options.numPeakBands ? 6.f : 0.f);
+        setParameter(processor, getPeakParameterID(band, "Bypassed"), band == 0 && config.peakBypassed ? 1.f : 0.f);
+    }
+
+    //prepareToPlay designs the filters from the parameters we've just set, we don't have a message thread to do it
+    processor.setPlayConfigDetails(options.numChannels, options.numChannels, config.sampleRate, config.blockSize);
+    processor.prepareToPlay(config.sampleRate, config.blockSize);
+}
+
+static BenchmarkResult run(SimpleEQAudioProcessor& processor, const BenchmarkConfig& config, const BenchmarkOptions& options)
+{
+    configure(processor, config, options);
+
+    // Each run processes the same noise, block by block, straight out of one long buffer
+    const auto numBlocks = juce::jmax(8, juce::roundToInt(options.secondsPerRun * config.sampleRate / config.blockSize));
+    const auto numSamples = numBlocks * config.blockSize;
+
+    juce::AudioBuffer<float> noise(options.numChannels, numSamples), source(options.numChannels, numSamples);
+    juce::Random random(0x5eed);
+
+    for( int channel = 0; channel < options.numChannels; ++channel )
+    {
+        auto* data = noise.getWritePointer(channel);
+        for( int i = 0; i < numSamples; ++i )
+            data[i] = random.nextFloat() * 2.f - 1.f;
+    }
+
+    juce::MidiBuffer midi;
+    std::vector<double> nsPerSample;
+
+    //the first run only warms the caches up
+    for( int repetition = 0; repetition <= options.repetitions; ++repetition )
+    {
+        source.makeCopyOf(noise, true);
+
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for( int block = 0; block < numBlocks; ++block )
+        {
+            juce::AudioBuffer<float> buffer(source.getArrayOfWritePointers(), options.numChannels, block * config.blockSize, config.blockSize);
+            processor.processBlock(buffer, midi);
+        }
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+        if( repetition > 0 )
+            nsPerSample.push_back(elapsed * 1.0e9 / numSamples);
+    }
+
+    processor.releaseResources();
+
+    std::sort(nsPerSample.begin(), nsPerSample.end());
+
+    BenchmarkResult result;
+    result.config = config;
+    result.medianNsPerSample = nsPerSample[nsPerSample.size() / 2];
+    result.minNsPerSample = nsPerSample.front();
+    return result;
+}
+
+static juce::Array<BenchmarkConfig> makeConfigs(const BenchmarkOptions& options)
+{
+    juce::Array<BenchmarkConfig> configs;
+
+    auto numBypassPermutations = options.allBypassPermutations ? 8 : 1;
+
+    juce::Array<SmoothingMode> smoothingModes { Smoothing_Off };
+    if( options.allSmoothingModes )
+        smoothingModes.addArray(juce::Array<SmoothingMode> { Smoothing_16, Smoothing_32, Smoothing_64 });
+
+    juce::Array<bool> phaseModes { false };
+    if( options.linearPhase )
+        phaseModes.add(true);
+
+    for( auto sampleRate : options.sampleRates )
+        for( auto blockSize : options.blockSizes )
+            for( auto lowCutSlope : options.slopes )
+                for( auto highCutSlope : options.slopes )
+                    for( int bypass = 0; bypass < numBypassPermutations; ++bypass )
+                        for( auto smoothing : smoothingModes )
+                            for( auto linearPhase : phaseModes )
+                            {
+                                BenchmarkConfig config;
+                                config.sampleRate = sampleRate;
+                                config.blockSize = blockSize;
+                                config.lowCutSlope = lowCutSlope;
+                                config.highCutSlope = highCutSlope;
+                                config.lowCutBypassed = (bypass & 1) != 0;
+                                config.peakBypassed = (bypass & 2) != 0;
+                                config.highCutBypassed = (bypass & 4) != 0;
+                                config.smoothing = smoothing;
+                                config.linearPhase = linearPhase;
+                                configs.add(config);
+                            }
+
+    return configs;
+}
+
+//fills in the baseline fields of every result that has a match in the baseline file, and returns how many regressed
+static int compareWithBaseline(juce::Array<BenchmarkResult>& results, const BenchmarkOptions& options)
+{
+    auto baseline = juce::JSON::parse(options.baseline);
+
+    std::map<juce::String, double> baselineNsPerSample;
+    if( auto* baselineResults = baseline["results"].getArray() )
+    {
+        for( auto& entry : *baselineResults )
+            baselineNsPerSample[entry["name"].toString()] = (double)entry["nsPerSample"];
+    }
+
+    if( baselineNsPerSample.empty() )
+        std::cerr << "no results found in the baseline " << options.baseline.getFullPathName() << std::endl;
+
+    int numRegressions = 0;
+
+    for( auto& result : results )
+    {
+        auto match = baselineNsPerSample.find(result.config.getName());
+        if( match == baselineNsPerSample.end() || match->second <= 0 )
+            continue;
+
+        result.hasBaseline = true;
+        result.baselineNsPerSample = match->second;
+        result.deltaPercent = (result.medianNsPerSample / match->second - 1.0) * 100.0;
+
+        if( result.deltaPercent > options.regressionThresholdPercent )
+            ++numRegressions;
+    }
+
+    return numRegressions;
+}
+
+static juce::String toJSON(const juce::Array<BenchmarkResult>& results, const BenchmarkOptions& options, int numRegressions)
+{
+    juce::Array<juce::var> entries;
+
+    for( auto& result : results )
+    {
+        auto& config = result.config;
+        auto* entry = new juce::DynamicObject();
+
+        entry->setProperty("name", config.getName());
+        entry->setProperty("sampleRate", config.sampleRate);
+        entry->setProperty("blockSize", config.blockSize);
+        entry->setProperty("lowCutSlope", BenchmarkConfig::getSlopeInDecibels(config.lowCutSlope));
+        entry->setProperty("highCutSlope", BenchmarkConfig::getSlopeInDecibels(config.highCutSlope));
+        entry->setProperty("lowCutBypassed", config.lowCutBypassed);
+        entry->setProperty("peakBypassed", config.peakBypassed);
+        entry->setProperty("highCutBypassed", config.highCutBypassed);
+        entry->setProperty("smoothing", getSmoothingSubBlockSize(config.smoothing));
+        entry->setProperty("linearPhase", config.linearPhase);
+        entry->setProperty("nsPerSample", result.medianNsPerSample);
+        entry->setProperty("minNsPerSample", result.minNsPerSample);
+
+        if( result.hasBaseline )
+        {
+            entry->setProperty("baselineNsPerSample", result.baselineNsPerSample);
+            entry->setProperty("deltaPercent", result.deltaPercent);
+            entry->setProperty("regression", result.deltaPercent > options.regressionThresholdPercent);
+        }
+
+        entries.add(juce::var(entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("benchmark", "SimpleEQAudioProcessor::processBlock");
+    root->setProperty("channels", options.numChannels);
+    root->setProperty("peakBands", options.numPeakBands);
+    root->setProperty("results", entries);
+
+    if( options.baseline != juce::File() )
+    {
+        root->setProperty("baseline", options.baseline.getFullPathName());
+        root->setProperty("regressionThresholdPercent", options.regressionThresholdPercent);
+        root->setProperty("regressions", numRegressions);
+    }
+
+    return juce::JSON::toString(juce::var(root));
+}
+
+static juce::String toCSV(const juce::Array<BenchmarkResult>& results, const BenchmarkOptions& options)
+{
+    juce::String csv;
+    csv << "name,sampleRate,blockSize,lowCutSlope,highCutSlope,lowCutBypassed,peakBypassed,highCutBypassed,"
+           "smoothing,linearPhase,nsPerSample,minNsPerSample,baselineNsPerSample,deltaPercent,regression\n";
+
+    for( auto& result : results )
+    {
+        auto& config = result.config;
+
+        csv << config.getName() << ','
+            << juce::roundToInt(config.sampleRate) << ','
+            << config.blockSize << ','
+            << BenchmarkConfig::getSlopeInDecibels(config.lowCutSlope) << ','
+            << BenchmarkConfig::getSlopeInDecibels(config.highCutSlope) << ','
+            << (int)config.lowCutBypassed << ','
+            << (int)config.peakBypassed << ','
+            << (int)config.highCutBypassed << ','
+            << getSmoothingSubBlockSize(config.smoothing) << ','
+            << (int)config.linearPhase << ','
+            << juce::String(result.medianNsPerSample, 3) << ','
+            << juce::String(result.minNsPerSample, 3) << ',';
+
+        if( result.hasBaseline )
+        {
+            csv << juce::String(result.baselineNsPerSample, 3) << ','
+                << juce::String(result.deltaPercent, 2) << ','
+                << (int)(result.deltaPercent > options.regressionThresholdPercent);
+        }
+        else
+        {
+            csv << ",,";
+        }
+
+        csv << '\n';
+    }
+
+    return csv;
+}
+
+//==============================================================================
+struct AnalyzerResult
+{
+    int order = 0;
+    double scalarNsPerBin = 0, fastNsPerBin = 0;
+    float maxErrorInDecibels = 0;
+};
+
+/*
+ function() handles numItems things (bins, frequencies...) at a time.
+ Returns the median of the timed runs in ns per item, after one run to warm the caches up.
+ */
+template<typename Function>
+static double timePerItem(Function&& function, int numItems, const BenchmarkOptions& options)
+{
+    // Enough calls to take about as long as a processBlock run, so the clock's resolution doesn't matter
+    const auto numCalls = juce::jmax(16, juce::roundToInt(options.secondsPerRun * 1.0e8 / numItems));
+    std::vector<double> nsPerItem;
+
+    for( int repetition = 0; repetition <= options.repetitions; ++repetition )
+    {
+        auto start = juce::Time::getHighResolutionTicks();
+
+        for( int i = 0; i < numCalls; ++i )
+            function();
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+
+        if( repetition > 0 )
+            nsPerItem.push_back(elapsed * 1.0e9 / ((double)numCalls * numItems));
+    }
+
+    std::sort(nsPerItem.begin(), nsPerItem.end());
+    return nsPerItem[nsPerItem.size() / 2];
+}
+
+/*
+ Turns one spectrum's bins into decibels the way FFTDataGenerator does, at every FFTOrder the analyzer offers.
+ "scalar" is the three passes it used to make: zero the output, take each bin's magnitude, normalize it
+ while replacing NaNs and infinities, then convert one bin at a time with juce::Decibels.
+ "fast" is what it does now: take each bin's power, then scale, clean up and convert in one FastDecibels pass.
+ */
+static juce::Array<AnalyzerResult> runAnalyzer(const BenchmarkOptions& options)
+{
+    juce::Array<AnalyzerResult> results;
+    juce::Random random(0x5eed);
+    const auto negativeInfinity = -48.f;
+
+    for( int order = 11; order <= 13; ++order )
+    {
+        const auto numBins = (1 << order) / 2;
+
+        // Bins spread over a wide range of levels, so plenty of them end up below negativeInfinity
+        std::vector<std::complex<float>> bins((size_t)numBins);
+        for( auto& bin : bins )
+            bin = std::polar(std::pow(10.f, random.nextFloat() * 6.f - 2.f), random.nextFloat() * juce::MathConstants<float>::twoPi);
+
+        std::vector<float> scalar, fast((size_t)numBins);
+
+        AnalyzerResult result;
+        result.order = order;
+
+        result.scalarNsPerBin = timePerItem([&]
+        {
+            scalar.assign((size_t)numBins, 0.f);
+
+            for( int i = 0; i < numBins; ++i )
+                scalar[(size_t)i] = std::abs(bins[(size_t)i]);
+
+            for( int i = 0; i < numBins; ++i )
+            {
+                auto v = scalar[(size_t)i];
+                if( ! std::isinf(v) && ! std::isnan(v) )
+                    v /= float(numBins);
+                else
+                    v = 0.f;
+                scalar[(size_t)i] = v;
+            }
+
+            for( int i = 0; i < numBins; ++i )
+                scalar[(size_t)i] = juce::Decibels::gainToDecibels(scalar[(size_t)i], negativeInfinity);
+        }, numBins, options);
+
+        result.fastNsPerBin = timePerItem([&]
+        {
+            for( int i = 0; i < numBins; ++i )
+                fast[(size_t)i] = std::norm(bins[(size_t)i]);
+
+            FastDecibels::powersToDecibels(fast.data(), numBins, 1.f / float(numBins * numBins), negativeInfinity);
+        }, numBins, options);
+
+        for( int i = 0; i < numBins; ++i )
+            result.maxErrorInDecibels = juce::jmax(result.maxErrorInDecibels, std::abs(fast[(size_t)i] - scalar[(size_t)i]));
+
+        results.add(result);
+    }
+
+    return results;
+}
+
+static juce::String toText(const juce::Array<AnalyzerResult>& results, bool csv)
+{
+    if( csv )
+    {
+        juce::String text;
+        text << "order,fftSize,scalarNsPerBin,fastNsPerBin,speedup,maxErrorInDecibels\n";
+
+        for( auto& result : results )
+            text << result.order << ',' << (1 << result.order) << ','
+                 << juce::String(result.scalarNsPerBin, 3) << ',' << juce::String(result.fastNsPerBin, 3) << ','
+                 << juce::String(result.scalarNsPerBin / result.fastNsPerBin, 2) << ','
+                 << juce::String(result.maxErrorInDecibels, 6) << '\n';
+
+        return text;
+    }
+
+    juce::Array<juce::var> entries;
+
+    for( auto& result : results )
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty("order", result.order);
+        entry->setProperty("fftSize", 1 << result.order);
+        entry->setProperty("scalarNsPerBin", result.scalarNsPerBin);
+        entry->setProperty("fastNsPerBin", result.fastNsPerBin);
+        entry->setProperty("speedup", result.scalarNsPerBin / result.fastNsPerBin);
+        entry->setProperty("maxErrorInDecibels", result.maxErrorInDecibels);
+        entries.add(juce::var(entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("benchmark", "FFTDataGenerator decibel conversion");
+    root->setProperty("errorBoundInDecibels", FastDecibels::maxErrorInDecibels);
+    root->setProperty("results", entries);
+
+    return juce::JSON::toString(juce::var(root));
+}
+
+//==============================================================================
+struct ResponseResult
+{
+    double sampleRate = 0;
+    int numFrequencies = 0, numSections = 0;
+    double referenceNsPerFrequency = 0, batchNsPerFrequency = 0;
+    double maxRelativeError = 0, maxPhaseError = 0;
+};
+
+/*
+ Evaluates the whole chain with every filter active, at as many log spaced frequencies as a wide response curve has pixels,
+ once one frequency at a time with getMagnitudeForFrequency and once with MagnitudeResponse.
+ The phases are checked against the argument of the same complex response getMagnitudeForFrequency takes the magnitude of.
+ */
+static juce::Array<ResponseResult> runResponse(const BenchmarkOptions& options)
+{
+    juce::Array<ResponseResult> results;
+
+    ChainSettings chainSettings;
+    chainSettings.lowCutFreq = 80.f;
+    chainSettings.highCutFreq = 12000.f;
+    chainSettings.lowCutSlope = chainSettings.highCutSlope = Slope_48;
+
+    for( int band = 0; band < NumPeakBands; ++band )
+    {
+        auto& settings = chainSettings.peakBands[(size_t)band];
+        settings.freq = juce::mapToLog10((band + 0.5f) / NumPeakBands, 20.f, 20000.f);
+        settings.gainInDecibels = band % 2 == 0 ? 6.f : -6.f;
+        settings.type = static_cast<BandType>(band % 3);
+    }
+
+    const int numFrequencies = 1024;
+    std::vector<double> frequencies((size_t)numFrequencies);
+    for( int i = 0; i < numFrequencies; ++i )
+        frequencies[(size_t)i] = juce::mapToLog10(double(i) / double(numFrequencies), 20.0, 20000.0);
+
+    for( auto sampleRate : options.sampleRates )
+    {
+        auto chainCoefficients = makeChainCoefficients(chainSettings, sampleRate);
+
+        std::vector<BiquadCoefficients> sections;
+        for( const auto* cut : { &chainCoefficients.lowCut, &chainCoefficients.highCut } )
+            sections.insert(sections.end(), cut->sections.begin(), cut->sections.begin() + cut->getNumSections());
+
+        const auto& peaks = chainCoefficients.peaks;
+        sections.insert(sections.end(), peaks.bands.begin(), peaks.bands.begin() + peaks.numActiveBands);
+
+        MagnitudeResponse response;
+        response.prepare(frequencies.data(), numFrequencies, sampleRate);
+
+        std::vector<double> reference((size_t)numFrequencies), batch((size_t)numFrequencies), phases((size_t)numFrequencies);
+
+        ResponseResult result;
+        result.sampleRate = sampleRate;
+        result.numFrequencies = numFrequencies;
+        result.numSections = (int)sections.size();
+
+        result.referenceNsPerFrequency = timePerItem([&]
+        {
+            for( int i = 0; i < numFrequencies; ++i )
+                reference[(size_t)i] = getMagnitudeForFrequency(chainCoefficients, frequencies[(size_t)i], sampleRate);
+        }, numFrequencies, options);
+
+        result.batchNsPerFrequency = timePerItem([&]
+        {
+            getMagnitudes(chainCoefficients, response, batch.data());
+        }, numFrequencies, options);
+
+        response.getPhases(sections.data(), (int)sections.size(), phases.data());
+
+        for( int i = 0; i < numFrequencies; ++i )
+        {
+            auto expected = reference[(size_t)i];
+            if( expected > 0 )
+                result.maxRelativeError = juce::jmax(result.maxRelativeError, std::abs(batch[(size_t)i] / expected - 1.0));
+
+            const auto jw = std::polar(1.0, -juce::MathConstants<double>::twoPi * frequencies[(size_t)i] / sampleRate);
+            std::complex<double> h = 1.0;
+
+            for( auto& c : sections )
+                h *= ((double)c.b0 + (double)c.b1 * jw + (double)c.b2 * jw * jw) / (1.0 + (double)c.a1 * jw + (double)c.a2 * jw * jw);
+
+            //the phases are wrapped, so only the distance around the circle counts
+            auto phaseError = std::abs(std::remainder(phases[(size_t)i] - std::arg(h), juce::MathConstants<double>::twoPi));
+            result.maxPhaseError = juce::jmax(result.maxPhaseError, phaseError);
+        }
+
+        results.add(result);
+    }
+
+    return results;
+}
+
+static juce::String toText(const juce::Array<ResponseResult>& results, bool csv)
+{
+    if( csv )
+    {
+        juce::String text;
+        text << "sampleRate,numFrequencies,numSections,referenceNsPerFrequency,batchNsPerFrequency,speedup,maxRelativeError,maxPhaseError\n";
+
+        for( auto& result : results )
+            text << juce::roundToInt(result.sampleRate) << ',' << result.numFrequencies << ',' << result.numSections << ','
+                 << juce::String(result.referenceNsPerFrequency, 3) << ',' << juce::String(result.batchNsPerFrequency, 3) << ','
+                 << juce::String(result.referenceNsPerFrequency / result.batchNsPerFrequency, 2) << ','
+                 << juce::String(result.maxRelativeError, 15) << ',' << juce::String(result.maxPhaseError, 15) << '\n';
+
+        return text;
+    }
+
+    juce::Array<juce::var> entries;
+
+    for( auto& result : results )
+    {
+        auto* entry = new juce::DynamicObject();
+        entry->setProperty("sampleRate", result.sampleRate);
+        entry->setProperty("numFrequencies", result.numFrequencies);
+        entry->setProperty("numSections", result.numSections);
+        entry->setProperty("referenceNsPerFrequency", result.referenceNsPerFrequency);
+        entry->setProperty("batchNsPerFrequency", result.batchNsPerFrequency);
+        entry->setProperty("speedup", result.referenceNsPerFrequency / result.batchNsPerFrequency);
+        entry->setProperty("maxRelativeError", result.maxRelativeError);
+        entry->setProperty("maxPhaseError", result.maxPhaseError);
+        entries.add(juce::var(entry));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("benchmark", "MagnitudeResponse");
+    root->setProperty("toleranceRelative", MagnitudeResponse::maxRelativeError);
+    root->setProperty("results", entries);
+
+    return juce::JSON::toString(juce::var(root));
+}
+
+//==============================================================================
+template<typename ValueType>
+static juce::Array<ValueType> parseList(const juce::String& text)
+{
+    juce::Array<ValueType> values;
+
+    for( auto& token : juce::StringArray::fromTokens(text, ",", "") )
+        if( token.trim().isNotEmpty() )
+            values.add(static_cast<ValueType>(token.trim().getDoubleValue()));
+
+    return values;
+}
+
+static bool parseOptions(const juce::StringArray& args, BenchmarkOptions& options)
+{
+    for( int i = 0; i < args.size(); ++i )
+    {
+        auto arg = args[i];
+        auto hasValue = i + 1 < args.size();
+
+        if( arg == "--block-sizes" && hasValue )
+        {
+            options.blockSizes = parseList<int>(args[++i]);
+        }
+        else if( arg == "--sample-rates" && hasValue )
+        {
+            options.sampleRates = parseList<double>(args[++i]);
+        }
+        else if( arg == "--slopes" && hasValue )
+        {
+            options.slopes.clear();
+            for( auto decibels : parseList<int>(args[++i]) )
+            {
+                if( decibels % 12 != 0 || decibels < 12 || decibels > 48 )
+                    return false;
+
+                options.slopes.add(static_cast<Slope>(decibels / 12 - 1));
+            }
+        }
+        else if( arg == "--bypass" && hasValue )
+        {
+            options.allBypassPermutations = args[++i] != "none";
+        }
+        else if( arg == "--smoothing" && hasValue )
+        {
+            options.allSmoothingModes = args[++i] == "all";
+        }
+        else if( arg == "--linear-phase" )
+        {
+            options.linearPhase = true;
+        }
+        else if( arg == "--peak-bands" && hasValue )
+        {
+            options.numPeakBands = juce::jlimit(0, NumPeakBands, args[++i].getIntValue());
+        }
+        else if( arg == "--channels" && hasValue )
+        {
+            options.numChannels = juce::jmax(1, args[++i].getIntValue());
+        }
+        else if( arg == "--repetitions" && hasValue )
+        {
+            options.repetitions = juce::jmax(1, args[++i].getIntValue());
+        }
+        else if( arg == "--seconds" && hasValue )
+        {
+            options.secondsPerRun = juce::jmax(0.001, args[++i].getDoubleValue());
+        }
+        else if( arg == "--format" && hasValue )
+        {
+            options.csv = args[++i] == "csv";
+        }
+        else if( arg == "--output" && hasValue )
+        {
+            options.output = juce::File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        }
+        else if( arg == "--baseline" && hasValue )
+        {
+            options.baseline = juce::File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        }
+        else if( arg == "--threshold" && hasValue )
+        {
+            options.regressionThresholdPercent = args[++i].getDoubleValue();
+        }
+        else if( arg == "--fail-on-regression" )
+        {
+            options.failOnRegression = true;
+        }
+        else if( arg == "--rt-check" )
+        {
+            options.realtimeCheck = true;
+        }
+        else if( arg == "--analyzer" )
+        {
+            options.analyzer = true;
+        }
+        else if( arg == "--response" )
+        {
+            options.response = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return ! options.blockSizes.isEmpty() && ! options.sampleRates.isEmpty() && ! options.slopes.isEmpty();
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for( int i = 1; i < argc; ++i )
+        args.add(juce::CharPointer_UTF8(argv[i]));
+
+    BenchmarkOptions options;
+    if( ! parseOptions(args, options) )
+    {
+        std::cerr << "usage: SimpleEQBenchmark [--block-sizes <list>] [--sample-rates <list>] [--slopes <list>]\n"
+                     "                         [--bypass all|none] [--smoothing all|off] [--linear-phase] [--peak-bands <n>]\n"
+                     "                         [--channels <n>] [--repetitions <n>] [--seconds <s>] [--format json|csv]\n"
+                     "                         [--output <file>] [--baseline <file>] [--threshold <percent>] [--fail-on-regression]\n"
+                     "                         [--rt-check] [--analyzer] [--response]" << std::endl;
+        return 1;
+    }
+
+   #if ! SIMPLEEQ_RT_CHECKS
+    if( options.realtimeCheck )
+    {
+        std::cerr << "--rt-check needs a build with SIMPLEEQ_RT_CHECKS=1, like the RealtimeChecks configuration" << std::endl;
+        return 1;
+    }
+   #endif
+
+    // These time a single piece of the editor or the processor on its own, rather than processBlock
+    if( options.analyzer || options.response )
+    {
+        auto withinTolerance = true;
+        juce::String text;
+
+        if( options.analyzer )
+        {
+            text = toText(runAnalyzer(options), options.csv);
+        }
+        else
+        {
+            auto results = runResponse(options);
+            text = toText(results, options.csv);
+
+            for( auto& result : results )
+                withinTolerance = withinTolerance && result.maxRelativeError <= MagnitudeResponse::maxRelativeError;
+        }
+
+        if( options.output != juce::File() )
+        {
+            if( ! options.output.replaceWithText(text) )
+            {
+                std::cerr << "can't write " << options.output.getFullPathName() << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << text << std::endl;
+        }
+
+        if( ! withinTolerance )
+        {
+            std::cerr << "MagnitudeResponse is further from getMagnitudeForFrequency than its tolerance of "
+                      << MagnitudeResponse::maxRelativeError << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    SimpleEQAudioProcessor processor;
+
+    auto configs = makeConfigs(options);
+    juce::Array<BenchmarkResult> results;
+
+    for( int i = 0; i < configs.size(); ++i )
+    {
+        results.add(run(processor, configs.getReference(i), options));
+
+        //progress goes to stderr so it never ends up in the results
+        std::cerr << "\r" << (i + 1) << "/" << configs.size() << std::flush;
+    }
+
+    std::cerr << std::endl;
+
+    int numRegressions = 0;
+    if( options.baseline != juce::File() )
+        numRegressions = compareWithBaseline(results, options);
+
+    auto text = options.csv ? toCSV(results, options) : toJSON(results, options, numRegressions);
+
+    if( options.output != juce::File() )
+    {
+        if( ! options.output.replaceWithText(text) )
+        {
+            std::cerr << "can't write " << options.output.getFullPathName() << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        std::cout << text << std::endl;
+    }
+
+    if( options.baseline != juce::File() )
+        std::cerr << numRegressions << " of " << results.size() << " configurations regressed by more than "
+                  << options.regressionThresholdPercent << "%" << std::endl;
+
+   #if SIMPLEEQ_RT_CHECKS
+    // Every configuration has been through processBlock by now, so anything it allocated or locked has been seen
+    if( RealtimeSafetyChecker::getNumViolations() > 0 )
+    {
+        std::cerr << RealtimeSafetyChecker::getReport() << std::endl;
+
+        if( options.realtimeCheck )
+            return 1;
+    }
+   #endif
+
+    return options.failOnRegression && numRegressions > 0 ? 1 : 0;
+}
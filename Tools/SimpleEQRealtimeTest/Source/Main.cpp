@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Fails if SimpleEQAudioProcessor::processBlock allocates or locks anything.
+
+    Every mode is run for a while, with the parameters moving between blocks and the message thread
+    running in between, so the timer redesigns the filters, starts the workers and builds kernels
+    the same way it would in a host. Exits with 1 and prints where it happened if the checker saw anything.
+
+    Only meaningful in a build with SIMPLEEQ_RT_CHECKS=1, which is how this project builds it.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/RealtimeSafetyChecker.h"
+
+#include <functional>
+#include <iostream>
+
+#if ! SIMPLEEQ_RT_CHECKS
+ #error "SimpleEQRealtimeTest needs SIMPLEEQ_RT_CHECKS=1"
+#endif
+
+struct TestCase
+{
+    juce::String name;
+    int numChannels = 2;
+    std::function<void(SimpleEQAudioProcessor&)> configure;
+
+    //called before each block, on the message thread
+    std::function<void(SimpleEQAudioProcessor&, int block)> update;
+};
+
+static constexpr double sampleRate = 48000;
+static constexpr int blockSize = 256;
+static constexpr int numBlocks = 300;
+
+//how long the message thread gets between blocks
+static constexpr int messageLoopMs = 5;
+
+static void setParameter(SimpleEQAudioProcessor& processor, const juce::String& id, float value)
+{
+    auto* param = processor.apvts.getParameter(id);
+    jassert(param != nullptr);
+
+    param->setValueNotifyingHost(param->convertTo0to1(value));
+}
+
+//sweeps the first band across the spectrum and back every hundred blocks, so there's always something to redesign
+static void sweepPeak(SimpleEQAudioProcessor& processor, int block)
+{
+    auto phase = (block % 100) / 100.f;
+    auto position = phase < 0.5f ? 2.f * phase : 2.f * (1.f - phase);
+
+    setParameter(processor, "Peak Freq", 20.f * std::pow(1000.f, position));
+}
+
+static bool run(const TestCase& test)
+{
+    SimpleEQAudioProcessor processor;
+
+    setParameter(processor, "Peak Gain", 6.f);
+    setParameter(processor, "LowCut Slope", (float)Slope_48);
+    setParameter(processor, "HighCut Slope", (float)Slope_48);
+
+    if( test.configure )
+        test.configure(processor);
+
+    processor.setPlayConfigDetails(test.numChannels, test.numChannels, sampleRate, blockSize);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    juce::AudioBuffer<float> buffer(test.numChannels, blockSize);
+    juce::MidiBuffer midi;
+    juce::Random random(0x5eed);
+
+    RealtimeSafetyChecker::reset();
+
+    for( int block = 0; block < numBlocks; ++block )
+    {
+        if( test.update )
+            test.update(processor, block);
+
+        juce::MessageManager::getInstance()->runDispatchLoopUntil(messageLoopMs);
+
+        for( int channel = 0; channel < test.numChannels; ++channel )
+        {
+            auto* data = buffer.getWritePointer(channel);
+            for( int i = 0; i < blockSize; ++i )
+                data[i] = random.nextFloat() * 2.f - 1.f;
+        }
+
+        processor.processBlock(buffer, midi);
+    }
+
+    processor.releaseResources();
+
+    auto numViolations = RealtimeSafetyChecker::getNumViolations();
+    std::cerr << (numViolations == 0 ? "passed: " : "FAILED: ") << test.name << std::endl;
+
+    if( numViolations > 0 )
+        std::cerr << RealtimeSafetyChecker::getReport() << std::endl;
+
+    return numViolations == 0;
+}
+
+//==============================================================================
+int main (int, char*[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::Array<TestCase> tests;
+
+    tests.add({ "filters", 2, {}, sweepPeak });
+
+    tests.add({ "smoothing", 2,
+                [](auto& processor) { setParameter(processor, "Smoothing", (float)Smoothing_32); },
+                sweepPeak });
+
+    //enough channels for more than one group, so the workers have something to do
+    tests.add({ "parallel channels", 8,
+                [](auto& processor) { setParameter(processor, "Parallel Channels", 1.f); },
+                sweepPeak });
+
+    tests.add({ "linear phase", 2,
+                [](auto& processor) { setParameter(processor, "Linear Phase", 1.f); },
+                sweepPeak });
+
+    //on and off again mid-stream, so both directions of the switch get run
+    tests.add({ "linear phase switching", 2, {},
+                [](auto& processor, int block)
+                {
+                    sweepPeak(processor, block);
+
+                    if( block == numBlocks / 3 || block == 2 * numBlocks / 3 )
+                        setParameter(processor, "Linear Phase", block == numBlocks / 3 ? 1.f : 0.f);
+                } });
+
+    auto numFailed = 0;
+
+    for( auto& test : tests )
+        if( ! run(test) )
+            ++numFailed;
+
+    std::cerr << (tests.size() - numFailed) << " of " << tests.size() << " passed" << std::endl;
+
+    return numFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,359 @@
+/*
+  ==============================================================================
+
+    Main.cpp
+
+    Renders audio files through SimpleEQAudioProcessor without a host or an editor.
+
+    SimpleEQRender [options] <input files...>
+
+      --output <dir>          where to write the results (default: next to each input)
+      --suffix <text>         appended to each output file name (default: "_eq")
+      --state <file>          plugin state to load, either what getStateInformation wrote or its XML
+      --param <ID>=<value>    sets a parameter in its own units, e.g. "Peak Gain=-3". Can be repeated.
+      --jobs <n>              number of files to render at once (default: one per core)
+      --block <n>             samples per processBlock call (default: 8192)
+      --list-params           prints the parameter IDs and ranges, then exits
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+
+#include "../../../Source/PluginProcessor.h"
+
+#include <atomic>
+#include <iostream>
+
+struct RenderSettings
+{
+    juce::File outputDirectory;
+    juce::String suffix { "_eq" };
+    juce::MemoryBlock state;
+    juce::StringPairArray parameters;
+    int blockSize = 8192;
+};
+
+//the state can be the binary ValueTree getStateInformation writes, or the same tree as XML
+static bool loadState(const juce::File& file, juce::MemoryBlock& state)
+{
+    if( ! file.loadFileAsData(state) )
+        return false;
+
+    if( auto xml = juce::parseXML(file) )
+    {
+        auto tree = juce::ValueTree::fromXml(*xml);
+        if( ! tree.isValid() )
+            return false;
+
+        state.reset();
+        juce::MemoryOutputStream mos(state, false);
+        tree.writeToStream(mos);
+    }
+
+    return state.getSize() > 0;
+}
+
+static bool applySettings(SimpleEQAudioProcessor& processor, const RenderSettings& settings, juce::String& error)
+{
+    if( settings.state.getSize() > 0 )
+        processor.setStateInformation(settings.state.getData(), (int)settings.state.getSize());
+
+    for( auto& id : settings.parameters.getAllKeys() )
+    {
+        auto* param = processor.apvts.getParameter(id);
+        if( param == nullptr )
+        {
+            error = "unknown parameter \"" + id + "\", use --list-params to see them all";
+            return false;
+        }
+
+        // Choices and switches can be given by name ("24 db/Oct", "true") as well as by number
+        auto text = settings.parameters[id];
+        auto value = juce::CharacterFunctions::isDigit(text[0]) || text.startsWithChar('-') || text.startsWithChar('.')
+                   ? param->convertTo0to1(text.getFloatValue())
+                   : param->getValueForText(text);
+
+        param->setValueNotifyingHost(value);
+    }
+
+    return true;
+}
+
+/*
+ Renders one file with a processor that's already set up.
+ The plugin's latency is compensated for, so the output lines up with the input sample for sample.
+ */
+static bool renderFile(SimpleEQAudioProcessor& processor,
+                       juce::AudioFormatManager& formatManager,
+                       const juce::File& input,
+                       const juce::File& output,
+                       int blockSize,
+                       juce::String& error)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(input));
+    if( reader == nullptr )
+    {
+        error = "can't read " + input.getFullPathName();
+        return false;
+    }
+
+    auto* format = formatManager.findFormatForFileExtension(output.getFileExtension());
+    if( format == nullptr )
+    {
+        error = "don't know how to write " + output.getFileExtension() + " files";
+        return false;
+    }
+
+    auto numChannels = (int)reader->numChannels;
+    auto sampleRate = reader->sampleRate;
+    auto numSamples = reader->lengthInSamples;
+
+    output.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream(output.createOutputStream());
+    if( stream == nullptr )
+    {
+        error = "can't write to " + output.getFullPathName();
+        return false;
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(),
+                                                                            sampleRate,
+                                                                            (unsigned int)numChannels,
+                                                                            (int)reader->bitsPerSample,
+                                                                            reader->metadataValues,
+                                                                            0));
+    if( writer == nullptr )
+    {
+        error = "can't write " + juce::String(reader->bitsPerSample) + " bit " + format->getFormatName()
+              + " files with " + juce::String(numChannels) + " channels";
+        return false;
+    }
+
+    //the writer owns the stream now
+    stream.release();
+
+    processor.setPlayConfigDetails(numChannels, numChannels, sampleRate, blockSize);
+    processor.setNonRealtime(true);
+    processor.prepareToPlay(sampleRate, blockSize);
+
+    // Whatever the plugin delays the audio by is skipped at the start,
+    // and made up for by running that many samples of silence through at the end
+    const juce::int64 latency = processor.getLatencySamples();
+    const auto totalSamples = numSamples + latency;
+
+    juce::AudioBuffer<float> buffer(numChannels, blockSize);
+    juce::MidiBuffer midi;
+
+    for( juce::int64 position = 0; position < totalSamples; position += blockSize )
+    {
+        auto count = (int)juce::jmin((juce::int64)blockSize, totalSamples - position);
+        buffer.setSize(numChannels, count, false, false, true);
+        buffer.clear();
+
+        if( position < numSamples )
+            reader->read(&buffer, 0, (int)juce::jmin((juce::int64)count, numSamples - position), position, true, true);
+
+        processor.processBlock(buffer, midi);
+
+        // position - latency is where this block's output belongs in the file
+        auto skip = (int)juce::jlimit((juce::int64)0, (juce::int64)count, latency - position);
+
+        if( skip < count && ! writer->writeFromAudioSampleBuffer(buffer, skip, count - skip) )
+        {
+            error = "failed writing " + output.getFullPathName();
+            processor.releaseResources();
+            return false;
+        }
+    }
+
+    processor.releaseResources();
+    return true;
+}
+
+/*
+ Each worker owns a processor and keeps taking the next file until there are none left,
+ so however many files there are, we only ever create as many processors as there are workers.
+ */
+struct RenderWorker : juce::Thread
+{
+    RenderWorker(const RenderSettings& s,
+                 const juce::Array<juce::File>& files,
+                 std::atomic<int>& next,
+                 std::atomic<int>& failures) :
+    juce::Thread("SimpleEQ render"),
+    settings(s),
+    inputFiles(files),
+    nextFile(next),
+    numFailures(failures)
+    {
+        formatManager.registerBasicFormats();
+    }
+
+    ~RenderWorker() override
+    {
+        stopThread(-1);
+    }
+
+    void run() override
+    {
+        for( auto index = nextFile++; index < inputFiles.size() && ! threadShouldExit(); index = nextFile++ )
+        {
+            auto& input = inputFiles.getReference(index);
+            auto directory = settings.outputDirectory == juce::File() ? input.getParentDirectory() : settings.outputDirectory;
+            auto output = directory.getChildFile(input.getFileNameWithoutExtension() + settings.suffix + input.getFileExtension());
+
+            juce::String error;
+
+            if( output == input )
+            {
+                log("ERROR: " + input.getFileName() + ": the output would overwrite the input, use --suffix or --output");
+                ++numFailures;
+                continue;
+            }
+
+            //every file starts from the same settings, whatever the last one left behind
+            if( applySettings(processor, settings, error) && renderFile(processor, formatManager, input, output, settings.blockSize, error) )
+            {
+                log(input.getFileName() + " -> " + output.getFullPathName());
+            }
+            else
+            {
+                log("ERROR: " + input.getFileName() + ": " + error);
+                ++numFailures;
+            }
+        }
+    }
+
+    static void log(const juce::String& message)
+    {
+        static juce::CriticalSection logLock;
+        const juce::ScopedLock lock(logLock);
+        std::cout << message << std::endl;
+    }
+private:
+    SimpleEQAudioProcessor processor;
+    const RenderSettings& settings;
+    const juce::Array<juce::File>& inputFiles;
+    std::atomic<int>& nextFile;
+    std::atomic<int>& numFailures;
+    juce::AudioFormatManager formatManager;
+};
+
+static void listParameters()
+{
+    SimpleEQAudioProcessor processor;
+
+    for( auto* param : processor.getParameters() )
+    {
+        if( auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(param) )
+        {
+            auto range = ranged->getNormalisableRange();
+            std::cout << ranged->paramID << ": " << range.start << " to " << range.end
+                      << " (default " << ranged->getCurrentValueAsText() << ")" << std::endl;
+        }
+    }
+}
+
+static void printUsage()
+{
+    std::cout << "usage: SimpleEQRender [--output <dir>] [--suffix <text>] [--state <file>] [--param <ID>=<value>]...\n"
+                 "                      [--jobs <n>] [--block <n>] [--list-params] <input files...>" << std::endl;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    RenderSettings settings;
+    juce::Array<juce::File> inputFiles;
+    auto numJobs = juce::SystemStats::getNumCpus();
+
+    juce::StringArray args;
+    for( int i = 1; i < argc; ++i )
+        args.add(juce::CharPointer_UTF8(argv[i]));
+
+    for( int i = 0; i < args.size(); ++i )
+    {
+        auto arg = args[i];
+        auto hasValue = i + 1 < args.size();
+
+        if( arg == "--list-params" )
+        {
+            listParameters();
+            return 0;
+        }
+        else if( arg == "--output" && hasValue )
+        {
+            settings.outputDirectory = juce::File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+        }
+        else if( arg == "--suffix" && hasValue )
+        {
+            settings.suffix = args[++i];
+        }
+        else if( arg == "--state" && hasValue )
+        {
+            auto file = juce::File::getCurrentWorkingDirectory().getChildFile(args[++i]);
+            if( ! loadState(file, settings.state) )
+            {
+                std::cerr << "can't load a state from " << file.getFullPathName() << std::endl;
+                return 1;
+            }
+        }
+        else if( arg == "--param" && hasValue )
+        {
+            auto assignment = args[++i];
+            if( ! assignment.containsChar('=') )
+            {
+                std::cerr << "--param needs <ID>=<value>, got \"" << assignment << "\"" << std::endl;
+                return 1;
+            }
+
+            settings.parameters.set(assignment.upToFirstOccurrenceOf("=", false, false).trim(),
+                                    assignment.fromFirstOccurrenceOf("=", false, false).trim());
+        }
+        else if( arg == "--jobs" && hasValue )
+        {
+            numJobs = juce::jmax(1, args[++i].getIntValue());
+        }
+        else if( arg == "--block" && hasValue )
+        {
+            settings.blockSize = juce::jmax(1, args[++i].getIntValue());
+        }
+        else if( arg.startsWith("--") )
+        {
+            printUsage();
+            return 1;
+        }
+        else
+        {
+            inputFiles.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg));
+        }
+    }
+
+    if( inputFiles.isEmpty() )
+    {
+        printUsage();
+        return 1;
+    }
+
+    if( settings.outputDirectory != juce::File() )
+        settings.outputDirectory.createDirectory();
+
+    std::atomic<int> nextFile { 0 };
+    std::atomic<int> numFailures { 0 };
+
+    // The processors are all created up front on this thread, the workers only ever use their own
+    std::vector<std::unique_ptr<RenderWorker>> workers;
+    for( int i = 0; i < juce::jmin(numJobs, inputFiles.size()); ++i )
+        workers.push_back(std::make_unique<RenderWorker>(settings, inputFiles, nextFile, numFailures));
+
+    for( auto& worker : workers )
+        worker->startThread();
+
+    for( auto& worker : workers )
+        worker->waitForThreadToExit(-1);
+
+    return numFailures > 0 ? 1 : 0;
+}